@@ -0,0 +1,56 @@
+#version 460 core
+#extension GL_ARB_bindless_texture : require
+in vec3 uv;
+in vec3 uv_back;
+flat in uint face_exposure;
+flat in uint face_exposure_back;
+flat in uint draw_index;
+out vec4 FragColor;
+
+// genericFragment.glsl for lattices drawn by a LatticeBatch, the texture and exposure mask
+// are bindless handles in the draw entry instead of bound units
+struct LatticeDraw
+{
+        mat4 model;
+        uvec2 texture_handle;
+        uvec2 exposure_handle;
+};
+layout (std430, binding = 1) readonly buffer LatticeDraws
+{
+        LatticeDraw draws[];
+};
+
+uniform float TIME;
+uniform vec2 RESOLUTION;
+
+void main()
+{
+        TIME;
+        RESOLUTION;
+
+        // shared planes show the layer behind them from either side, past the lattice there is none
+        vec3 coordinate = gl_FrontFacing ? uv : uv_back;
+        if (any(lessThan(coordinate, vec3(0.0))) || any(greaterThan(coordinate, vec3(1.0))))
+                discard;
+
+        // draw_index is flat per layer quad, neighbouring chunks can still share a subgroup
+        // which drivers without non uniform bindless access would have to split
+        LatticeDraw draw = draws[draw_index];
+
+        // buried faces are dropped before the colour is read, a zero handle has no mask
+        if (draw.exposure_handle != uvec2(0u))
+        {
+                usampler3D exposure = usampler3D(draw.exposure_handle);
+                ivec3 exposure_size = textureSize(exposure, 0);
+                ivec3 exposure_texel = clamp(ivec3(coordinate*vec3(exposure_size)), ivec3(0), exposure_size-1);
+                uint bit = gl_FrontFacing ? face_exposure : face_exposure_back;
+                if ((texelFetch(exposure, exposure_texel, 0).r & bit) == 0u)
+                        discard;
+        }
+
+        // batches draw every lattice at full detail, the base level of textures with lods
+        vec4 color = textureLod(sampler3D(draw.texture_handle), coordinate, 0.0);
+        if (color.a != 1.0)
+                discard;
+        FragColor = color;
+}
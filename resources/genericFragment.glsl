@@ -1,18 +1,72 @@
 #version 460 core
 in vec3 uv;
+in vec3 uv_back;
+flat in uint face_exposure;
+flat in uint face_exposure_back;
 out vec4 FragColor;
 
 uniform sampler3D TEXTURE;
 
+// per voxel bits of the directions it has an air neighbour in, on texture unit 1
+uniform usampler3D EXPOSURE;
+uniform bool EXPOSURE_MASK;
+
+// mip level of both textures the lattice's layers match, coarser levels are downsampled voxels
+uniform int TEXTURE_LEVEL;
+// texel holding texel (0,0,0) of what the layers show, coordinates wrap around past the far edge
+uniform ivec3 TEXTURE_ORIGIN;
+
+// brick entries on texture unit 2 when the colours live in a brick pool, see brick_pool.h,
+// TEXTURE is then the pool and every entry a slot of it or a BRICK_* marker
+uniform usampler3D INDIRECTION;
+uniform bool BRICKED;
+
+const int BRICK_SIZE = 8;
+const uint BRICK_UNIFORM = 0xFFFFFFFFu;
+const uint BRICK_MISSING = 0xFFFFFFFEu;
+
 uniform float TIME;
 uniform vec2 RESOLUTION;
 
+// colour of texel through its brick entry, slots are numbered x fastest through the pool
+vec4 brick_texel(ivec3 texel)
+{
+        uvec2 entry = texelFetch(INDIRECTION, texel/BRICK_SIZE, 0).rg;
+        if (entry.x == BRICK_UNIFORM)
+                return unpackUnorm4x8(entry.y);
+        // evicted, it is uploaded again once its chunk has been drawn
+        if (entry.x == BRICK_MISSING)
+                return vec4(0.0);
+
+        int slots = textureSize(TEXTURE, 0).x/BRICK_SIZE;
+        int slot = int(entry.x);
+        ivec3 brick = ivec3(slot%slots, slot/slots%slots, slot/(slots*slots));
+        return texelFetch(TEXTURE, brick*BRICK_SIZE+texel%BRICK_SIZE, 0);
+}
+
 void main()
 {
         TIME;
         RESOLUTION;
         
-        vec4 color = texture(TEXTURE, uv);
+        // shared planes show the layer behind them from either side, past the lattice there is none
+        vec3 coordinate = gl_FrontFacing ? uv : uv_back;
+        if (any(lessThan(coordinate, vec3(0.0))) || any(greaterThan(coordinate, vec3(1.0))))
+                discard;
+
+        // buried faces are dropped before the colour is read
+        if (EXPOSURE_MASK)
+        {
+                ivec3 exposure_size = textureSize(EXPOSURE, TEXTURE_LEVEL);
+                ivec3 exposure_texel = (clamp(ivec3(coordinate*vec3(exposure_size)), ivec3(0), exposure_size-1)+TEXTURE_ORIGIN)%exposure_size;
+                uint bit = gl_FrontFacing ? face_exposure : face_exposure_back;
+                if ((texelFetch(EXPOSURE, exposure_texel, TEXTURE_LEVEL).r & bit) == 0u)
+                        discard;
+        }
+
+        ivec3 size = BRICKED ? textureSize(INDIRECTION, 0)*BRICK_SIZE : textureSize(TEXTURE, TEXTURE_LEVEL);
+        ivec3 texel = (clamp(ivec3(coordinate*vec3(size)), ivec3(0), size-1)+TEXTURE_ORIGIN)%size;
+        vec4 color = BRICKED ? brick_texel(texel) : texelFetch(TEXTURE, texel, TEXTURE_LEVEL);
         if (color.a != 1.0)
                 discard;
         FragColor = color;
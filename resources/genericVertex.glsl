@@ -1,8 +1,15 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 UV;
+// layer, face << 2 | corner, see LatticeVertex in lattice.h
+layout (location = 0) in uvec2 VERTEX;
 
 out vec3 uv;
+// texture coordinate seen from behind, only different on shared planes
+out vec3 uv_back;
+// exposure bit of the direction the face shows, from the front and from behind
+flat out uint face_exposure;
+flat out uint face_exposure_back;
+// entry of draws the fragment shader reads its textures from when batched
+flat out uint draw_index;
 
 uniform float TIME;
 uniform vec2 RESOLUTION;
@@ -11,11 +18,133 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// voxels along every edge of the lattice and the edge length of a voxel
+uniform int LATTICE_SIZE;
+uniform float VOXEL_SCALE;
+// procedural lattices have no vertex buffer, the quad is found from gl_VertexID instead
+uniform bool PROCEDURAL;
+// Planes shared between neighbouring layers, LATTICE_SIZE+1 per axis, drawn double sided.
+// A plane uses the geometry of the axis' negative face whose layer is in front of it,
+// the layer behind it is the one whose positive face would sit in the same place.
+uniform bool SHARED_PLANES;
+// drawn by a LatticeBatch, the model matrix comes from the draw entry of gl_BaseInstance
+uniform bool BATCHED;
+
+// see LatticeDraw in lattice_batch.h, texture handles are read by the batched fragment shader
+struct LatticeDraw
+{
+        mat4 model;
+        uvec2 texture_handle;
+        uvec2 exposure_handle;
+};
+layout (std430, binding = 1) readonly buffer LatticeDraws
+{
+        LatticeDraw draws[];
+};
+
+// Faces come in groups of LATTICE_SIZE layers in the order -Z, +Z, -X, +X, -Y, +Y.
+// Every face is a quad spanned by two corner coordinates, walked in one of two orders
+// so both triangles keep the winding of the face.
+const vec2 CORNERS_A[4] = vec2[4](vec2(1,1), vec2(1,0), vec2(0,0), vec2(0,1));
+const vec2 CORNERS_B[4] = vec2[4](vec2(0,0), vec2(1,0), vec2(1,1), vec2(0,1));
+// the corners of the two triangles of a quad, matching the index buffer
+const int QUAD_CORNERS[6] = int[6](0, 1, 2, 2, 3, 0);
+// EXPOSURE_* bit of every face, towards the neighbour between the face and its viewer
+// along the texture axes, which run against world z and x
+const uint FACE_EXPOSURE[6] = uint[6](32u, 16u, 1u, 2u, 4u, 8u);
+
+// texture coordinate along the axis of a layer, nudged off 1.0 so it stays inside the last texel.
+// Layers outside the lattice end up outside [0, 1].
+float layer_coordinate(int axis, int layer)
+{
+        float last = float(max(LATTICE_SIZE-1, 1));
+        if (axis == 1)
+        {
+                float across = 1.0-layer/last;
+                if (layer == 0)
+                        across -= 0.000001;
+                return across;
+        }
+
+        float depth = layer/last;
+        if (layer == LATTICE_SIZE-1)
+                depth -= 0.000001;
+        return depth;
+}
+
 void main()
 {
         TIME;
         RESOLUTION;
 
-        uv = UV;
-        gl_Position = projection * view * model * vec4(aPos, 1.0f);
+        int face;
+        int layer;
+        int corner;
+        if (PROCEDURAL)
+        {
+                int layers = SHARED_PLANES ? LATTICE_SIZE+1 : LATTICE_SIZE;
+                int groups = SHARED_PLANES ? 3 : 6;
+                // the second half of the vertex IDs repeats every face with its layers reversed
+                int id = gl_VertexID%(6*layers*groups);
+                face = id/(6*layers);
+                layer = (id/6)%layers;
+                if (gl_VertexID >= 6*layers*groups)
+                        layer = layers-1-layer;
+                corner = QUAD_CORNERS[id%6];
+                if (SHARED_PLANES)
+                        face *= 2;
+        }
+        else
+        {
+                face = int(VERTEX.y >> 2);
+                layer = int(VERTEX.x);
+                corner = int(VERTEX.y & 3u);
+        }
+        int axis = face/2;
+        bool positive = (face&1) == 1;
+
+        // plane p lies on the negative face of layer p-1 and the positive face of layer p,
+        // y layers grow the other way so there it is the negative face of p and positive face of p-1
+        int back_layer = layer;
+        if (SHARED_PLANES)
+        {
+                back_layer = axis == 2 ? layer-1 : layer;
+                layer = axis == 2 ? layer : layer-1;
+        }
+
+        float extent = VOXEL_SCALE*LATTICE_SIZE;
+        float depth = layer_coordinate(axis, layer);
+
+        vec3 position;
+        if (axis == 0)
+        {
+                // Z layers, texture x runs against world x
+                vec2 c = positive ? CORNERS_B[corner] : CORNERS_A[corner];
+                position = vec3(c.x*extent, c.y*extent, -layer*VOXEL_SCALE + (positive ? VOXEL_SCALE : 0.0));
+                uv = vec3(1.0-c.x, c.y, depth);
+        }
+        else if (axis == 1)
+        {
+                // X layers, texture x and z both run against world x and z
+                vec2 c = positive ? CORNERS_A[corner] : CORNERS_B[corner];
+                position = vec3(layer*VOXEL_SCALE + (positive ? 0.0 : VOXEL_SCALE), c.y*extent, VOXEL_SCALE - c.x*extent);
+                uv = vec3(depth, c.y, c.x);
+        }
+        else
+        {
+                // Y layers
+                vec2 c = positive ? CORNERS_B[corner] : CORNERS_A[corner];
+                position = vec3(c.x*extent, layer*VOXEL_SCALE + (positive ? VOXEL_SCALE : 0.0), VOXEL_SCALE - c.y*extent);
+                uv = vec3(1.0-c.x, depth, c.y);
+        }
+
+        face_exposure = FACE_EXPOSURE[face];
+        face_exposure_back = SHARED_PLANES ? FACE_EXPOSURE[face+1] : face_exposure;
+
+        uv_back = uv;
+        uv_back[axis == 0 ? 2 : (axis == 1 ? 0 : 1)] = layer_coordinate(axis, back_layer);
+
+        draw_index = uint(gl_BaseInstance);
+        mat4 lattice_model = BATCHED ? draws[gl_BaseInstance].model : model;
+        gl_Position = projection * view * lattice_model * vec4(position, 1.0f);
 }
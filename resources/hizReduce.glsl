@@ -0,0 +1,49 @@
+#version 460 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// the depth texture when copying level 0, otherwise the pyramid itself
+uniform sampler2D SOURCE;
+uniform int SOURCE_LEVEL;
+uniform bool COPY;
+// level 0 comes from the reprojected depth instead, 0 marks pixels nothing landed on
+uniform bool REPROJECTED;
+uniform usampler2D REPROJECTED_SOURCE;
+
+layout (r32f, binding = 0) writeonly uniform image2D DESTINATION;
+
+void main()
+{
+        ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+        ivec2 size = imageSize(DESTINATION);
+        if (any(greaterThanEqual(texel, size)))
+                return;
+
+        if (COPY && REPROJECTED)
+        {
+                uint bits = texelFetch(REPROJECTED_SOURCE, texel, 0).r;
+                imageStore(DESTINATION, texel, vec4(bits == 0u ? 1.0 : uintBitsToFloat(bits)));
+                return;
+        }
+        if (COPY)
+        {
+                imageStore(DESTINATION, texel, vec4(texelFetch(SOURCE, texel, 0).r));
+                return;
+        }
+
+        // the last texel of a row or column also takes the odd source texel past it
+        ivec2 source_size = textureSize(SOURCE, SOURCE_LEVEL);
+        ivec2 first = texel*2;
+        ivec2 last = min(first+1, source_size-1);
+        if (texel.x == size.x-1)
+                last.x = source_size.x-1;
+        if (texel.y == size.y-1)
+                last.y = source_size.y-1;
+
+        float farthest = 0.0;
+        for (int y = first.y ; y <= last.y ; y++)
+        {
+                for (int x = first.x ; x <= last.x ; x++)
+                        farthest = max(farthest, texelFetch(SOURCE, ivec2(x, y), SOURCE_LEVEL).r);
+        }
+        imageStore(DESTINATION, texel, vec4(farthest));
+}
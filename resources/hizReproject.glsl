@@ -0,0 +1,35 @@
+#version 460 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// captured depth of the previous frame
+uniform sampler2D DEPTH;
+// projection*view of this frame times the inverse of the captured frame's
+uniform mat4 REPROJECTION;
+
+// farthest depth landing on every pixel as float bits, cleared to 0 beforehand.
+// Positive floats order like their bits, so the atomic max keeps the farthest.
+layout (r32ui, binding = 0) uniform uimage2D DESTINATION;
+
+void main()
+{
+        ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+        ivec2 size = textureSize(DEPTH, 0);
+        if (any(greaterThanEqual(texel, size)))
+                return;
+
+        // nothing was drawn there, the far plane is what an empty pixel means anyway
+        float depth = texelFetch(DEPTH, texel, 0).r;
+        if (depth >= 1.0)
+                return;
+
+        vec4 ndc = vec4((vec2(texel)+0.5)/vec2(size)*2.0-1.0, depth*2.0-1.0, 1.0);
+        vec4 clip = REPROJECTION*ndc;
+        if (clip.w <= 0.0)
+                return;
+        vec3 moved = clip.xyz/clip.w;
+        if (any(lessThan(moved, vec3(-1.0))) || any(greaterThan(moved, vec3(1.0))))
+                return;
+
+        ivec2 target = min(ivec2((moved.xy*0.5+0.5)*vec2(size)), size-1);
+        imageAtomicMax(DESTINATION, target, floatBitsToUint(moved.z*0.5+0.5));
+}
@@ -0,0 +1,67 @@
+#version 460 core
+in vec3 uv;
+in vec3 uv_back;
+flat in uint face_exposure;
+flat in uint face_exposure_back;
+out vec4 FragColor;
+
+// palette indices of the chunk, GL_R8UI or GL_R16UI
+uniform usampler3D TEXTURE;
+
+// per voxel bits of the directions it has an air neighbour in, on texture unit 1
+uniform usampler3D EXPOSURE;
+uniform bool EXPOSURE_MASK;
+
+// mip level of both textures the lattice's layers match, coarser levels are downsampled voxels
+uniform int TEXTURE_LEVEL;
+// texel holding texel (0,0,0) of what the layers show, coordinates wrap around past the far edge
+uniform ivec3 TEXTURE_ORIGIN;
+
+uniform float TIME;
+uniform vec2 RESOLUTION;
+
+// matches struct Voxel, 20 bytes per entry under std430
+struct Voxel
+{
+        float r;
+        float g;
+        float b;
+        float a;
+        int temperature;
+};
+
+layout(std430, binding = 0) readonly buffer Palette
+{
+        Voxel palette[];
+};
+
+void main()
+{
+        TIME;
+        RESOLUTION;
+
+        // shared planes show the layer behind them from either side, past the lattice there is none
+        vec3 coordinate = gl_FrontFacing ? uv : uv_back;
+        if (any(lessThan(coordinate, vec3(0.0))) || any(greaterThan(coordinate, vec3(1.0))))
+                discard;
+
+        // buried faces are dropped before the colour is read
+        if (EXPOSURE_MASK)
+        {
+                ivec3 exposure_size = textureSize(EXPOSURE, TEXTURE_LEVEL);
+                ivec3 exposure_texel = (clamp(ivec3(coordinate*vec3(exposure_size)), ivec3(0), exposure_size-1)+TEXTURE_ORIGIN)%exposure_size;
+                uint bit = gl_FrontFacing ? face_exposure : face_exposure_back;
+                if ((texelFetch(EXPOSURE, exposure_texel, TEXTURE_LEVEL).r & bit) == 0u)
+                        discard;
+        }
+
+        // integer textures can't be filtered, texelFetch reads the nearest index directly
+        ivec3 size = textureSize(TEXTURE, TEXTURE_LEVEL);
+        ivec3 texel = (clamp(ivec3(coordinate*vec3(size)), ivec3(0), size-1)+TEXTURE_ORIGIN)%size;
+        uint index = texelFetch(TEXTURE, texel, TEXTURE_LEVEL).r;
+
+        Voxel voxel = palette[index];
+        if (voxel.a != 1.0)
+                discard;
+        FragColor = vec4(voxel.r, voxel.g, voxel.b, voxel.a);
+}
@@ -0,0 +1,204 @@
+#version 460 core
+layout (local_size_x = 64) in;
+
+// One invocation per slot of a LatticeBatch. Slots outside the frustum or hidden behind the
+// previous frame's depth, reprojected into this frame, draw nothing, the others write a command for the front
+// facing, occupied layers of each of their 6 faces (or of both halves of their 3 shared
+// plane axes), see lattice_collect_runs for the CPU version.
+
+struct LatticeDraw
+{
+        mat4 model;
+        uvec2 texture_handle;
+        uvec2 exposure_handle;
+};
+layout (std430, binding = 1) readonly buffer LatticeDraws
+{
+        LatticeDraw draws[];
+};
+
+// see LatticeCullEntry in lattice_batch.h
+struct LatticeCullEntry
+{
+        vec4 low;
+        vec4 high;
+        ivec2 layers[6];
+};
+layout (std430, binding = 2) readonly buffer LatticeCullEntries
+{
+        LatticeCullEntry entries[];
+};
+
+// LatticeArraysCommand or LatticeElementsCommand words
+layout (std430, binding = 3) writeonly buffer LatticeCommands
+{
+        uint commands[];
+};
+layout (std430, binding = 4) buffer LatticeDrawCount
+{
+        uint draw_count;
+};
+
+uniform int SLOT_COUNT;
+uniform mat4 VIEW_PROJECTION;
+uniform vec3 CAMERA_POSITION;
+// GL_CULL_FACE is enabled, back facing layers are skipped
+uniform bool CULLING;
+// commands are appended through draw_count, otherwise every slot owns 6 of them
+uniform bool COMPACT;
+
+uniform int LATTICE_SIZE;
+uniform float VOXEL_SCALE;
+uniform bool PROCEDURAL;
+uniform bool SHARED_PLANES;
+
+// farthest depth pyramid of the previous frame as seen from PYRAMID_VIEW_PROJECTION, see hiz.h
+uniform bool HIZ;
+uniform sampler2D PYRAMID;
+uniform int PYRAMID_LEVELS;
+uniform mat4 PYRAMID_VIEW_PROJECTION;
+
+// the layer planes of every face, see lattice.cpp
+const int FACE_AXES[6] = int[6](2, 2, 0, 0, 1, 1);
+const float FACE_SLOPES[6] = float[6](-1.0, -1.0, 1.0, 1.0, 1.0, 1.0);
+const float FACE_OFFSETS[6] = float[6](0.0, 1.0, 1.0, 0.0, 0.0, 1.0);
+const float FACE_SIDES[6] = float[6](-1.0, 1.0, 1.0, -1.0, -1.0, 1.0);
+const float PLANE_SLOPES[3] = float[3](-1.0, 1.0, 1.0);
+const float PLANE_OFFSETS[3] = float[3](1.0, 0.0, 0.0);
+
+void emit(uint slot, int command, int first, int count)
+{
+        if (COMPACT && count <= 0)
+                return;
+
+        uint index = COMPACT ? atomicAdd(draw_count, 1u) : slot*6u+uint(command);
+        uint word = index*(PROCEDURAL ? 4u : 5u);
+        commands[word] = uint(max(count, 0))*6u;
+        commands[word+1u] = 1u;
+        commands[word+2u] = uint(first)*6u;
+        if (PROCEDURAL)
+        {
+                commands[word+3u] = slot;
+        }
+        else
+        {
+                commands[word+3u] = 0u;
+                commands[word+4u] = slot;
+        }
+}
+
+// layers [first, last) of group, nearest to the camera first when descending
+void emit_layers(uint slot, int command, int group, int first, int last, bool descending)
+{
+        int layers = SHARED_PLANES ? LATTICE_SIZE+1 : LATTICE_SIZE;
+        int groups = SHARED_PLANES ? 3 : 6;
+        // the reversed copy of every group follows the ascending ones
+        int base = descending ? groups*layers+group*layers+layers-last : group*layers+first;
+        emit(slot, command, base, last-first);
+}
+
+bool outside_frustum(vec3 low, vec3 high)
+{
+        for (int i = 0 ; i < 6 ; i++)
+        {
+                vec4 plane = vec4(VIEW_PROJECTION[0][3], VIEW_PROJECTION[1][3], VIEW_PROJECTION[2][3], VIEW_PROJECTION[3][3]);
+                vec4 row = vec4(VIEW_PROJECTION[0][i/2], VIEW_PROJECTION[1][i/2], VIEW_PROJECTION[2][i/2], VIEW_PROJECTION[3][i/2]);
+                plane += (i&1) == 0 ? row : -row;
+                // the corner of the box farthest along the plane normal
+                vec3 corner = mix(low, high, greaterThan(plane.xyz, vec3(0.0)));
+                if (dot(plane.xyz, corner)+plane.w < 0.0)
+                        return true;
+        }
+        return false;
+}
+
+// whether the box is behind the pyramid's depth everywhere it covers the screen
+bool hidden(vec3 low, vec3 high)
+{
+        vec2 rect_low = vec2(1.0);
+        vec2 rect_high = vec2(0.0);
+        float nearest = 1.0;
+        for (int i = 0 ; i < 8 ; i++)
+        {
+                vec3 corner = mix(low, high, bvec3((i&1) != 0, (i&2) != 0, (i&4) != 0));
+                vec4 clip = PYRAMID_VIEW_PROJECTION*vec4(corner, 1.0);
+                // reaches behind the camera, nothing to compare against
+                if (clip.w <= 0.0)
+                        return false;
+                vec3 ndc = clip.xyz/clip.w;
+                rect_low = min(rect_low, ndc.xy*0.5+0.5);
+                rect_high = max(rect_high, ndc.xy*0.5+0.5);
+                nearest = min(nearest, ndc.z*0.5+0.5);
+        }
+        // parts off the screen aren't in the pyramid
+        if (any(lessThan(rect_low, vec2(0.0))) || any(greaterThan(rect_high, vec2(1.0))))
+                return false;
+
+        // the level where the rectangle covers at most 2x2 texels
+        ivec2 size = textureSize(PYRAMID, 0);
+        ivec2 texel_low = min(ivec2(rect_low*vec2(size)), size-1);
+        ivec2 texel_high = min(ivec2(rect_high*vec2(size)), size-1);
+        int span = max(texel_high.x-texel_low.x, texel_high.y-texel_low.y);
+        int level = span <= 1 ? 0 : int(ceil(log2(float(span))));
+        level = min(level, PYRAMID_LEVELS-1);
+
+        // odd levels fold their last texel into the one before it
+        ivec2 level_size = textureSize(PYRAMID, level);
+        ivec2 a = min(texel_low >> level, level_size-1);
+        ivec2 b = min(texel_high >> level, level_size-1);
+        float farthest = max(max(texelFetch(PYRAMID, a, level).r, texelFetch(PYRAMID, ivec2(b.x, a.y), level).r),
+                             max(texelFetch(PYRAMID, ivec2(a.x, b.y), level).r, texelFetch(PYRAMID, b, level).r));
+        return nearest > farthest;
+}
+
+void main()
+{
+        uint slot = gl_GlobalInvocationID.x;
+        if (slot >= uint(SLOT_COUNT))
+                return;
+
+        LatticeCullEntry entry = entries[slot];
+        // free slots have a zero low.w, slots not reachable through air a zero high.w
+        bool visible = entry.low.w != 0.0 && entry.high.w != 0.0 && !outside_frustum(entry.low.xyz, entry.high.xyz);
+        if (visible && HIZ)
+                visible = !hidden(entry.low.xyz, entry.high.xyz);
+        if (!visible)
+        {
+                for (int i = 0 ; i < 6 ; i++)
+                        emit(slot, i, 0, 0);
+                return;
+        }
+
+        vec3 position = vec3(inverse(draws[slot].model)*vec4(CAMERA_POSITION, 1.0));
+        if (SHARED_PLANES)
+        {
+                // none of the double sided planes can be skipped for facing away,
+                // planes below the camera go towards plane 0 and the rest away from it
+                for (int axis = 0 ; axis < 3 ; axis++)
+                {
+                        float camera_plane = (position[FACE_AXES[axis*2]]/VOXEL_SCALE-PLANE_OFFSETS[axis])/PLANE_SLOPES[axis];
+                        int split = int(clamp(floor(camera_plane)+1.0, 0.0, float(LATTICE_SIZE+1)));
+                        ivec2 occupied = entry.layers[axis];
+                        emit_layers(slot, axis*2, axis, occupied.x, max(min(split, occupied.y), occupied.x), true);
+                        emit_layers(slot, axis*2+1, axis, min(max(split, occupied.x), occupied.y), occupied.y, false);
+                }
+                return;
+        }
+
+        for (int face = 0 ; face < 6 ; face++)
+        {
+                int first = entry.layers[face].x;
+                int last = entry.layers[face].y;
+                // side*(position-(slope*L+offset)*scale) > 0 solved for L, see lattice_visible_layers
+                bool descending = FACE_SIDES[face]*FACE_SLOPES[face] > 0.0;
+                if (CULLING)
+                {
+                        float bound = (position[FACE_AXES[face]]/VOXEL_SCALE-FACE_OFFSETS[face])/FACE_SLOPES[face];
+                        if (descending)
+                                last = min(last, int(clamp(ceil(bound), 0.0, float(LATTICE_SIZE))));
+                        else
+                                first = max(first, int(clamp(floor(bound)+1.0, 0.0, float(LATTICE_SIZE))));
+                }
+                emit_layers(slot, face, face, first, max(last, first), descending);
+        }
+}
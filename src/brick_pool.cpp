@@ -0,0 +1,152 @@
+#include "brick_pool.h"
+
+#include <stdio.h>
+#include <glad/gl.h>
+
+
+struct BrickPool create_brick_pool(int slots_per_axis)
+{
+        struct BrickPool result;
+
+        result.slots_per_axis = slots_per_axis;
+        result.slot_count = slots_per_axis*slots_per_axis*slots_per_axis;
+        result.newest = -1;
+        result.oldest = -1;
+        result.texture = 0;
+
+        int size = slots_per_axis*BRICK_SIZE;
+        int max_size = 0;
+        glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_size);
+        if (size > max_size)
+        {
+                printf("Unable to create a %d texel brick pool, 3D textures are limited to %d.\n",size,max_size);
+                result.slot_count = 0;
+                return result;
+        }
+
+        glGenTextures(1, &result.texture);
+        glBindTexture(GL_TEXTURE_3D, result.texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, size, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        // slot 0 is handed out first
+        result.free_slots.resize(result.slot_count);
+        for (int i = 0 ; i < result.slot_count ; i++)
+                result.free_slots[i] = result.slot_count-1-i;
+        struct BrickOwner nobody = {NULL, 0};
+        result.owners.assign(result.slot_count, nobody);
+        result.last_used.assign(result.slot_count, 0);
+        result.previous.assign(result.slot_count, -1);
+        result.next.assign(result.slot_count, -1);
+
+        return result;
+}
+
+
+void free_brick_pool(struct BrickPool* pool)
+{
+        if (pool->texture != 0)
+                glDeleteTextures(1, &pool->texture);
+        pool->texture = 0;
+        pool->free_slots.clear();
+        pool->owners.clear();
+        pool->last_used.clear();
+        pool->previous.clear();
+        pool->next.clear();
+        pool->newest = -1;
+        pool->oldest = -1;
+}
+
+
+static void brick_pool_unlink(struct BrickPool* pool, int slot)
+{
+        int previous = pool->previous[slot];
+        int next = pool->next[slot];
+        if (previous != -1)
+                pool->next[previous] = next;
+        else
+                pool->newest = next;
+        if (next != -1)
+                pool->previous[next] = previous;
+        else
+                pool->oldest = previous;
+        pool->previous[slot] = -1;
+        pool->next[slot] = -1;
+}
+
+
+static void brick_pool_link_newest(struct BrickPool* pool, int slot)
+{
+        pool->previous[slot] = -1;
+        pool->next[slot] = pool->newest;
+        if (pool->newest != -1)
+                pool->previous[pool->newest] = slot;
+        else
+                pool->oldest = slot;
+        pool->newest = slot;
+}
+
+
+int brick_pool_alloc(struct BrickPool* pool, void* owner, int brick, uint64_t frame, struct BrickOwner* evicted)
+{
+        evicted->owner = NULL;
+        evicted->brick = 0;
+
+        int slot;
+        if (!pool->free_slots.empty())
+        {
+                slot = pool->free_slots.back();
+                pool->free_slots.pop_back();
+        }
+        else
+        {
+                // the pool can't even hold what one frame draws
+                if (pool->oldest == -1 || pool->last_used[pool->oldest] == frame)
+                        return -1;
+                slot = pool->oldest;
+                brick_pool_unlink(pool, slot);
+                *evicted = pool->owners[slot];
+        }
+
+        pool->owners[slot].owner = owner;
+        pool->owners[slot].brick = brick;
+        pool->last_used[slot] = frame;
+        brick_pool_link_newest(pool, slot);
+        return slot;
+}
+
+
+void brick_pool_release(struct BrickPool* pool, int slot)
+{
+        brick_pool_unlink(pool, slot);
+        pool->owners[slot].owner = NULL;
+        pool->free_slots.push_back(slot);
+}
+
+
+void brick_pool_touch(struct BrickPool* pool, int slot, uint64_t frame)
+{
+        if (pool->last_used[slot] == frame)
+                return;
+        pool->last_used[slot] = frame;
+        brick_pool_unlink(pool, slot);
+        brick_pool_link_newest(pool, slot);
+}
+
+
+void brick_pool_upload(struct BrickPool* pool, int slot, const unsigned char* texels, int row_length)
+{
+        int slots = pool->slots_per_axis;
+        int x = slot%slots*BRICK_SIZE;
+        int y = slot/slots%slots*BRICK_SIZE;
+        int z = slot/(slots*slots)*BRICK_SIZE;
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+        glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, row_length);
+        glBindTexture(GL_TEXTURE_3D, pool->texture);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, x, y, z, BRICK_SIZE, BRICK_SIZE, BRICK_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+// edge length in voxels of a pool brick, chunk sizes have to be a multiple of it
+#define BRICK_SIZE 8
+// first word of an indirection entry without a slot, a uniform brick keeps its RGBA8 colour
+// in the second word and a missing brick was evicted and is reloaded once it is drawn again
+#define BRICK_UNIFORM 0xFFFFFFFFu
+#define BRICK_MISSING 0xFFFFFFFEu
+
+
+// brick a pool slot holds, owner is whatever the caller allocated it for
+typedef struct BrickOwner
+{
+        void* owner;
+        int brick;
+}BrickOwner;
+
+
+// One GL_RGBA8 3D texture of slots_per_axis^3 bricks shared by every chunk. Chunks keep an
+// indirection texture of GL_RG32UI entries, a pool slot or a BRICK_* marker per brick, so
+// only bricks with more than one colour take up a slot.
+// Slots in use are kept in least recently used order, a full pool hands out the slot that
+// went longest without being drawn unless it was drawn in the current frame.
+typedef struct BrickPool
+{
+        unsigned int texture;
+        int slots_per_axis;
+        int slot_count;
+        std::vector<int> free_slots;
+        std::vector<struct BrickOwner> owners;
+        // frame every slot was last drawn in
+        std::vector<uint64_t> last_used;
+        // doubly linked list of the slots in use, most recently used first, -1 ends it
+        std::vector<int> previous;
+        std::vector<int> next;
+        int newest;
+        int oldest;
+}BrickPool;
+
+
+// texture is 0 if it couldn't be created
+struct BrickPool create_brick_pool(int slots_per_axis);
+void free_brick_pool(struct BrickPool* pool);
+
+// Slot for brick of owner drawn in frame, evicting the least recently used slot if the pool
+// is full and writing its previous owner to evicted (owner NULL when nothing was evicted).
+// Returns -1 if every slot was drawn in frame.
+int brick_pool_alloc(struct BrickPool* pool, void* owner, int brick, uint64_t frame, struct BrickOwner* evicted);
+void brick_pool_release(struct BrickPool* pool, int slot);
+// marks slot as drawn in frame
+void brick_pool_touch(struct BrickPool* pool, int slot, uint64_t frame);
+
+// uploads a brick of RGBA8 texels to slot, rows of the brick are row_length texels apart
+// and slices row_length rows apart
+void brick_pool_upload(struct BrickPool* pool, int slot, const unsigned char* texels, int row_length);
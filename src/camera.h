@@ -0,0 +1,19 @@
+#pragma once
+
+#include "glm/gtc/type_ptr.hpp"
+
+typedef struct Camera
+{
+        const float fov = 70.0f;
+        float speed = 0.25f;
+        const float sensitivity = 0.05f;
+        float yaw=90.f,pitch;
+        glm::vec3 position = glm::vec3(0.0f,0.0f,-1.0f);
+        //glm::vec3 target = glm::vec3(0.0f,0.0f,0.0f);
+        glm::vec3 direction;// = glm::normalize(position - target);
+        glm::vec3 front;
+        glm::vec3 up;
+        glm::vec3 right;
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection;
+}Camera;
@@ -0,0 +1,357 @@
+#include "chunk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+int voxel_equal(struct Voxel a, struct Voxel b)
+{
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a && a.temperature == b.temperature;
+}
+
+
+static unsigned char colour_channel(float value)
+{
+        if (value <= 0.0f)
+                return 0x00;
+        if (value >= 1.0f)
+                return 0xFF;
+        return (unsigned char)(value*255.0f+0.5f);
+}
+
+
+uint32_t voxel_to_rgba(struct Voxel voxel)
+{
+        unsigned char texel[4] = {colour_channel(voxel.r), colour_channel(voxel.g), colour_channel(voxel.b), colour_channel(voxel.a)};
+        uint32_t result;
+        memcpy(&result, texel, sizeof(result));
+        return result;
+}
+
+
+static size_t chunk_word_count(int size, int bits)
+{
+        size_t voxel_count = (size_t)size*size*size;
+        size_t per_word = 64/bits;
+        return (voxel_count+per_word-1)/per_word;
+}
+
+
+static inline int chunk_read(const uint64_t* data, int bits, size_t i)
+{
+        size_t per_word = 64/bits;
+        uint64_t mask = (1ull << bits)-1;
+        return (int)((data[i/per_word] >> ((i%per_word)*bits)) & mask);
+}
+
+
+static inline void chunk_write(uint64_t* data, int bits, size_t i, int value)
+{
+        size_t per_word = 64/bits;
+        uint64_t mask = (1ull << bits)-1;
+        int shift = (i%per_word)*bits;
+        uint64_t* word = data+i/per_word;
+        *word = (*word & ~(mask << shift)) | (((uint64_t)value & mask) << shift);
+}
+
+
+struct Chunk create_chunk(int size, struct Voxel fill)
+{
+        struct Chunk result;
+
+        result.size = size;
+        result.bits = 1;
+        result.palette_capacity = 4;
+        result.palette_size = 1;
+        result.palette = (struct Voxel*) malloc(result.palette_capacity*sizeof(struct Voxel));
+        result.data_size = chunk_word_count(size, result.bits);
+        result.data = (uint64_t*) calloc(result.data_size, sizeof(uint64_t));
+
+        if (result.palette == NULL || result.data == NULL)
+        {
+                printf("Unable to allocate chunk of size %d.\n",size);
+                free(result.palette);
+                free(result.data);
+                result.palette = NULL;
+                result.data = NULL;
+                result.palette_size = 0;
+                result.palette_capacity = 0;
+                result.data_size = 0;
+                return result;
+        }
+
+        *result.palette = fill;
+
+        return result;
+}
+
+
+void free_chunk(struct Chunk* chunk)
+{
+        free(chunk->palette);
+        free(chunk->data);
+        chunk->palette = NULL;
+        chunk->data = NULL;
+        chunk->palette_size = 0;
+        chunk->palette_capacity = 0;
+        chunk->data_size = 0;
+}
+
+
+// widens every index to new_bits, returns -1 if the new storage can't be allocated
+static int chunk_repack(struct Chunk* chunk, int new_bits)
+{
+        size_t word_count = chunk_word_count(chunk->size, new_bits);
+        uint64_t* data = (uint64_t*) calloc(word_count, sizeof(uint64_t));
+        if (data == NULL)
+        {
+                printf("Unable to repack chunk to %d bits per voxel.\n",new_bits);
+                return -1;
+        }
+
+        size_t voxel_count = (size_t)chunk->size*chunk->size*chunk->size;
+        for (size_t i = 0 ; i < voxel_count ; i++)
+                chunk_write(data, new_bits, i, chunk_read(chunk->data, chunk->bits, i));
+
+        free(chunk->data);
+        chunk->data = data;
+        chunk->data_size = word_count;
+        chunk->bits = new_bits;
+        return 0;
+}
+
+
+int chunk_palette_index(struct Chunk* chunk, struct Voxel voxel)
+{
+        for (int i = 0 ; i < chunk->palette_size ; i++)
+        {
+                if (voxel_equal(*(chunk->palette+i), voxel))
+                        return i;
+        }
+
+        if (chunk->palette_size >= CHUNK_MAX_PALETTE_SIZE)
+        {
+                printf("chunk palette is full, unable to add a new voxel type.\n");
+                return -1;
+        }
+
+        if (chunk->palette_size+1 > (1 << chunk->bits))
+        {
+                int new_bits = chunk->bits*2;
+                if (chunk_repack(chunk, new_bits) != 0)
+                        return -1;
+        }
+
+        if (chunk->palette_size == chunk->palette_capacity)
+        {
+                int new_capacity = chunk->palette_capacity*2;
+                struct Voxel* palette = (struct Voxel*) realloc(chunk->palette, new_capacity*sizeof(struct Voxel));
+                if (palette == NULL)
+                {
+                        printf("Unable to grow chunk palette.\n");
+                        return -1;
+                }
+                chunk->palette = palette;
+                chunk->palette_capacity = new_capacity;
+        }
+
+        *(chunk->palette+chunk->palette_size) = voxel;
+        chunk->palette_size++;
+        return chunk->palette_size-1;
+}
+
+
+int chunk_get_index(const struct Chunk* chunk, int x, int y, int z)
+{
+        size_t i = x + (size_t)chunk->size*(y + (size_t)chunk->size*z);
+        return chunk_read(chunk->data, chunk->bits, i);
+}
+
+
+struct Voxel chunk_get(const struct Chunk* chunk, int x, int y, int z)
+{
+        return *(chunk->palette+chunk_get_index(chunk, x, y, z));
+}
+
+
+void chunk_set_index(struct Chunk* chunk, int x, int y, int z, int palette_index)
+{
+        size_t i = x + (size_t)chunk->size*(y + (size_t)chunk->size*z);
+        chunk_write(chunk->data, chunk->bits, i, palette_index);
+}
+
+
+int chunk_set(struct Chunk* chunk, int x, int y, int z, struct Voxel voxel)
+{
+        int palette_index = chunk_palette_index(chunk, voxel);
+        if (palette_index == -1)
+                return -1;
+        chunk_set_index(chunk, x, y, z, palette_index);
+        return 0;
+}
+
+
+void chunk_fill(struct Chunk* chunk, struct Voxel voxel)
+{
+        size_t word_count = chunk_word_count(chunk->size, 1);
+        if (chunk->bits != 1)
+        {
+                uint64_t* data = (uint64_t*) realloc(chunk->data, word_count*sizeof(uint64_t));
+                if (data == NULL)
+                {
+                        printf("Unable to shrink chunk data.\n");
+                        return;
+                }
+                chunk->data = data;
+                chunk->data_size = word_count;
+                chunk->bits = 1;
+        }
+        memset(chunk->data, 0, word_count*sizeof(uint64_t));
+
+        *chunk->palette = voxel;
+        chunk->palette_size = 1;
+}
+
+
+size_t chunk_memory_usage(const struct Chunk* chunk)
+{
+        return sizeof(struct Chunk) + chunk->palette_capacity*sizeof(struct Voxel) + chunk->data_size*sizeof(uint64_t);
+}
+
+
+void chunk_to_rgba(const struct Chunk* chunk, unsigned char* out)
+{
+        uint32_t* colours = (uint32_t*) malloc(chunk->palette_size*sizeof(uint32_t));
+        if (colours == NULL)
+        {
+                printf("Unable to allocate the chunk colour table.\n");
+                return;
+        }
+        for (int i = 0 ; i < chunk->palette_size ; i++)
+                *(colours+i) = voxel_to_rgba(*(chunk->palette+i));
+
+        // walk whole words so the packed data is streamed once instead of re-indexed per voxel
+        size_t voxel_count = (size_t)chunk->size*chunk->size*chunk->size;
+        size_t per_word = 64/chunk->bits;
+        uint64_t mask = (1ull << chunk->bits)-1;
+        size_t i = 0;
+        for (size_t w = 0 ; w < chunk->data_size ; w++)
+        {
+                uint64_t word = *(chunk->data+w);
+                for (size_t j = 0 ; j < per_word && i < voxel_count ; j++, i++)
+                {
+                        uint32_t texel = *(colours+(word & mask));
+                        memcpy(out+i*4, &texel, sizeof(texel));
+                        word >>= chunk->bits;
+                }
+        }
+
+        free(colours);
+}
+
+
+typedef struct ChunkSerialHeader
+{
+        uint32_t palette_size;
+        uint32_t bits;
+}ChunkSerialHeader;
+
+
+// palette rounded up so the packed words stay 8 byte aligned in the payload
+static size_t chunk_serialized_palette_size(int palette_size)
+{
+        return (palette_size*sizeof(struct Voxel)+7) & ~(size_t)7;
+}
+
+
+size_t chunk_serialized_size(const struct Chunk* chunk)
+{
+        return sizeof(struct ChunkSerialHeader) + chunk_serialized_palette_size(chunk->palette_size) + chunk->data_size*sizeof(uint64_t);
+}
+
+
+size_t chunk_max_serialized_size(int size)
+{
+        return sizeof(struct ChunkSerialHeader) + chunk_serialized_palette_size(CHUNK_MAX_PALETTE_SIZE) + chunk_word_count(size, 16)*sizeof(uint64_t);
+}
+
+
+void chunk_serialize(const struct Chunk* chunk, unsigned char* out)
+{
+        struct ChunkSerialHeader header = {(uint32_t)chunk->palette_size, (uint32_t)chunk->bits};
+        size_t palette_bytes = chunk_serialized_palette_size(chunk->palette_size);
+
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        memset(out, 0, palette_bytes);
+        memcpy(out, chunk->palette, chunk->palette_size*sizeof(struct Voxel));
+        out += palette_bytes;
+        memcpy(out, chunk->data, chunk->data_size*sizeof(uint64_t));
+}
+
+
+int chunk_deserialize(const unsigned char* data, size_t length, int size, struct Chunk* out)
+{
+        struct ChunkSerialHeader header;
+        if (length < sizeof(header))
+                return -1;
+        memcpy(&header, data, sizeof(header));
+
+        if (header.bits != 1 && header.bits != 2 && header.bits != 4 && header.bits != 8 && header.bits != 16)
+                return -1;
+        if (header.palette_size == 0 || header.palette_size > CHUNK_MAX_PALETTE_SIZE || header.palette_size > (1u << header.bits))
+                return -1;
+
+        size_t palette_bytes = chunk_serialized_palette_size(header.palette_size);
+        size_t word_count = chunk_word_count(size, header.bits);
+        if (length < sizeof(header) + palette_bytes + word_count*sizeof(uint64_t))
+                return -1;
+
+        struct Chunk result;
+        result.size = size;
+        result.bits = header.bits;
+        result.palette_size = header.palette_size;
+        result.palette_capacity = header.palette_size;
+        result.palette = (struct Voxel*) malloc(result.palette_capacity*sizeof(struct Voxel));
+        result.data_size = word_count;
+        result.data = (uint64_t*) malloc(word_count*sizeof(uint64_t));
+        if (result.palette == NULL || result.data == NULL)
+        {
+                printf("Unable to allocate chunk of size %d.\n",size);
+                free(result.palette);
+                free(result.data);
+                return -1;
+        }
+
+        data += sizeof(header);
+        memcpy(result.palette, data, result.palette_size*sizeof(struct Voxel));
+        data += palette_bytes;
+        memcpy(result.data, data, word_count*sizeof(uint64_t));
+
+        // every index has to name a palette entry, a full palette can't be indexed past
+        if (result.palette_size < (1 << result.bits))
+        {
+                size_t voxel_count = (size_t)size*size*size;
+                size_t per_word = 64/result.bits;
+                uint64_t mask = (1ull << result.bits)-1;
+                size_t i = 0;
+                for (size_t w = 0 ; w < word_count ; w++)
+                {
+                        uint64_t word = *(result.data+w);
+                        for (size_t j = 0 ; j < per_word && i < voxel_count ; j++, i++)
+                        {
+                                if ((int)(word & mask) >= result.palette_size)
+                                {
+                                        free(result.palette);
+                                        free(result.data);
+                                        return -1;
+                                }
+                                word >>= result.bits;
+                        }
+                }
+        }
+
+        *out = result;
+        return 0;
+}
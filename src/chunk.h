@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 20 bytes per voxel
+// this only meant to be stored in a block palette
+// or a something like that, we need to avoid instancing it for every single instance
+typedef struct Voxel
+{
+        float r;
+        float g;
+        float b;
+        float a;
+        int temperature;
+}Voxel;
+
+
+// A cubic chunk of voxels stored as a local palette plus bit packed palette indices.
+// The index width starts at 1 bit and grows (1, 2, 4, 8, 16) only when the palette
+// outgrows it, so a chunk with 3 block types costs 2 bits per voxel instead of an int.
+// Voxels are addressed x fastest, then y, then z which is the same layout glTexSubImage3D expects.
+typedef struct Chunk
+{
+        int size;
+        struct Voxel* palette;
+        int palette_size;
+        int palette_capacity;
+        // bits per index, always one of 1, 2, 4, 8, 16
+        int bits;
+        uint64_t* data;
+        // number of 64 bit words in data
+        size_t data_size;
+}Chunk;
+
+
+#define CHUNK_MAX_PALETTE_SIZE 65536
+
+int voxel_equal(struct Voxel a, struct Voxel b);
+// packs a voxel colour into the RGBA8 byte order used by the lattice textures
+uint32_t voxel_to_rgba(struct Voxel voxel);
+
+struct Chunk create_chunk(int size, struct Voxel fill);
+void free_chunk(struct Chunk* chunk);
+
+// returns the palette index of voxel, adding it (and repacking if required) when it is new
+// returns -1 if the palette is full
+int chunk_palette_index(struct Chunk* chunk, struct Voxel voxel);
+
+int chunk_get_index(const struct Chunk* chunk, int x, int y, int z);
+struct Voxel chunk_get(const struct Chunk* chunk, int x, int y, int z);
+void chunk_set_index(struct Chunk* chunk, int x, int y, int z, int palette_index);
+// returns -1 and leaves the voxel alone if voxel can't be added to the palette
+int chunk_set(struct Chunk* chunk, int x, int y, int z, struct Voxel voxel);
+// resets the chunk to a single voxel type, dropping the old palette
+void chunk_fill(struct Chunk* chunk, struct Voxel voxel);
+
+size_t chunk_memory_usage(const struct Chunk* chunk);
+
+// writes size^3 RGBA8 texels to out
+void chunk_to_rgba(const struct Chunk* chunk, unsigned char* out);
+
+// flat copy of a chunk (palette and packed indices) used for region files,
+// the format is native endian and is only meant to be read back by chunk_deserialize
+size_t chunk_serialized_size(const struct Chunk* chunk);
+void chunk_serialize(const struct Chunk* chunk, unsigned char* out);
+// the largest chunk_serialized_size of a chunk of size, a full palette at 16 bits per voxel
+size_t chunk_max_serialized_size(int size);
+// returns -1 if data isn't a valid chunk of the given size, including indices past its palette
+int chunk_deserialize(const unsigned char* data, size_t length, int size, struct Chunk* out);
@@ -0,0 +1,100 @@
+#include "clipmap.h"
+
+#include <stdio.h>
+#include <glad/gl.h>
+
+
+// size^3 texture wrapping around on every axis
+static unsigned int clipmap_create_texture(int size, GLint internal_format, GLenum format, GLenum type)
+{
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, internal_format, size, size, size, 0, format, type, 0);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        // empty slots show nothing, every face of them is buried
+        unsigned int nothing = 0;
+        glClearTexImage(texture, 0, format, type, &nothing);
+        return texture;
+}
+
+
+struct Clipmap create_clipmap(struct Lattice lattice, int chunk_size, int chunks)
+{
+        struct Clipmap result;
+
+        result.lattice = lattice;
+        result.chunk_size = chunk_size;
+        result.chunks = chunks;
+        result.origin = glm::ivec3(0);
+        result.base_matrix = lattice.model_matrix;
+        result.lattice.texture = 0;
+        result.lattice.exposure = 0;
+        result.lattice.palette_buffer = 0;
+        result.lattice.occupancy = NULL;
+
+        int size = chunk_size*chunks;
+        if (lattice.width != size)
+        {
+                printf("Unable to create a clipmap of %d chunks with a %d layer lattice.\n",chunks,lattice.width);
+                return result;
+        }
+
+        result.lattice.texture = clipmap_create_texture(size, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        result.lattice.exposure = clipmap_create_texture(size, GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
+        clipmap_move(&result, result.origin);
+
+        return result;
+}
+
+
+void free_clipmap(struct Clipmap* clipmap)
+{
+        if (clipmap->lattice.texture != 0)
+                glDeleteTextures(1, &clipmap->lattice.texture);
+        if (clipmap->lattice.exposure != 0)
+                glDeleteTextures(1, &clipmap->lattice.exposure);
+        clipmap->lattice.texture = 0;
+        clipmap->lattice.exposure = 0;
+}
+
+
+static int clipmap_wrap(int value, int divisor)
+{
+        int remainder = value%divisor;
+        return remainder < 0 ? remainder+divisor : remainder;
+}
+
+
+glm::ivec3 clipmap_chunk_slot(const struct Clipmap* clipmap, glm::ivec3 position)
+{
+        int chunks = clipmap->chunks;
+        return glm::ivec3(clipmap_wrap(position.x, chunks), clipmap_wrap(position.y, chunks), clipmap_wrap(position.z, chunks))*clipmap->chunk_size;
+}
+
+
+bool clipmap_contains(const struct Clipmap* clipmap, glm::ivec3 position)
+{
+        glm::ivec3 offset = position-clipmap->origin;
+        return offset.x >= 0 && offset.y >= 0 && offset.z >= 0 &&
+               offset.x < clipmap->chunks && offset.y < clipmap->chunks && offset.z < clipmap->chunks;
+}
+
+
+void clipmap_move(struct Clipmap* clipmap, glm::ivec3 origin)
+{
+        clipmap->origin = origin;
+
+        // texture x runs against world x, so the window's texel 0 sits at its far x chunk,
+        // the same translations as chunk lattices otherwise
+        float extent = clipmap->chunk_size*clipmap->lattice.voxel_scale;
+        glm::vec3 translation = glm::vec3(-(origin.x+clipmap->chunks-1)*extent, origin.y*extent, -origin.z*extent);
+        clipmap->lattice.model_matrix = glm::translate(clipmap->base_matrix, translation);
+        clipmap->lattice.texture_origin = clipmap_chunk_slot(clipmap, origin);
+}
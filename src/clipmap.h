@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include "lattice.h"
+
+
+// One global lattice over a window of chunks around the camera. Its textures are addressed
+// toroidally, chunk c always sits in slot c mod chunks along every axis, so when the window
+// moves only the chunks entering it are uploaded, over the slots of the chunks leaving it.
+// The lattice's model matrix snaps to the window and texture_origin rotates the texels under it.
+typedef struct Clipmap
+{
+        // chunks*chunk_size layers, texture and exposure are the window's
+        struct Lattice lattice;
+        int chunk_size;
+        // chunks along every edge of the window
+        int chunks;
+        // chunk coordinate of the window's lowest chunk
+        glm::ivec3 origin;
+        // model matrix of the lattice when chunk (0,0,0) is its lowest
+        glm::mat4 base_matrix;
+}Clipmap;
+
+
+// lattice has to be chunks*chunk_size layers wide, texture is 0 if it isn't or the textures
+// couldn't be created. Both textures start out empty.
+struct Clipmap create_clipmap(struct Lattice lattice, int chunk_size, int chunks);
+void free_clipmap(struct Clipmap* clipmap);
+
+// texel of the window textures voxel (0,0,0) of chunk position is uploaded to
+glm::ivec3 clipmap_chunk_slot(const struct Clipmap* clipmap, glm::ivec3 position);
+bool clipmap_contains(const struct Clipmap* clipmap, glm::ivec3 position);
+// moves the window so origin is its lowest chunk, nothing is uploaded
+void clipmap_move(struct Clipmap* clipmap, glm::ivec3 origin);
@@ -0,0 +1,304 @@
+#include "codec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEC_MIN_MATCH 4
+#define CODEC_MAX_OFFSET 65535
+#define CODEC_HASH_BITS 14
+// matches stop this far from the end so the match finder's 8 byte compares stay in bounds
+#define CODEC_LAST_LITERALS 8
+// unmatched literals speed up the search, incompressible data is skipped instead of hashed byte by byte
+#define CODEC_SKIP_SHIFT 6
+
+
+static inline uint32_t codec_read32(const unsigned char* p)
+{
+        uint32_t result;
+        memcpy(&result, p, sizeof(result));
+        return result;
+}
+
+
+static inline uint64_t codec_read64(const unsigned char* p)
+{
+        uint64_t result;
+        memcpy(&result, p, sizeof(result));
+        return result;
+}
+
+
+static inline uint32_t codec_hash(uint32_t value)
+{
+        return (value*2654435761u) >> (32-CODEC_HASH_BITS);
+}
+
+
+// fixed size copies compile to single vector moves, callers make sure both sides have the room
+static inline void codec_copy8(unsigned char* dst, const unsigned char* src)
+{
+        memcpy(dst, src, 8);
+}
+
+
+static inline void codec_copy16(unsigned char* dst, const unsigned char* src)
+{
+        memcpy(dst, src, 16);
+}
+
+
+static unsigned char* codec_write_length(unsigned char* op, size_t length)
+{
+        while (length >= 255)
+        {
+                *op++ = 255;
+                length -= 255;
+        }
+        *op++ = (unsigned char)length;
+        return op;
+}
+
+
+static unsigned char* codec_write_sequence(unsigned char* op, const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+        unsigned char* token = op++;
+        size_t match_code = match_length-CODEC_MIN_MATCH;
+
+        *token = (unsigned char)(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15));
+        if (literal_length >= 15)
+                op = codec_write_length(op, literal_length-15);
+        memcpy(op, literals, literal_length);
+        op += literal_length;
+
+        *op++ = (unsigned char)(offset & 0xFF);
+        *op++ = (unsigned char)(offset >> 8);
+        if (match_code >= 15)
+                op = codec_write_length(op, match_code-15);
+        return op;
+}
+
+
+static unsigned char* codec_write_last_literals(unsigned char* op, const unsigned char* literals, size_t literal_length)
+{
+        *op++ = (unsigned char)((literal_length < 15 ? literal_length : 15) << 4);
+        if (literal_length >= 15)
+                op = codec_write_length(op, literal_length-15);
+        memcpy(op, literals, literal_length);
+        return op+literal_length;
+}
+
+
+size_t codec_compress_bound(size_t length)
+{
+        return CODEC_HEADER_SIZE + length + length/255 + 16;
+}
+
+
+size_t codec_compress(const unsigned char* in, size_t length, unsigned char* out)
+{
+        if (length > 0xFFFFFFFFu)
+                return 0;
+
+        out[0] = (unsigned char)(length & 0xFF);
+        out[1] = (unsigned char)((length >> 8) & 0xFF);
+        out[2] = (unsigned char)((length >> 16) & 0xFF);
+        out[3] = (unsigned char)((length >> 24) & 0xFF);
+        unsigned char* op = out+CODEC_HEADER_SIZE;
+
+        const unsigned char* src = in;
+        uint32_t* table = (uint32_t*) calloc((size_t)1 << CODEC_HASH_BITS, sizeof(uint32_t));
+        if (table == NULL)
+        {
+                printf("Unable to allocate the codec hash table.\n");
+                return 0;
+        }
+
+        size_t anchor = 0;
+        size_t ip = 0;
+        size_t match_end = length > CODEC_LAST_LITERALS ? length-CODEC_LAST_LITERALS : 0;
+        while (ip+CODEC_MIN_MATCH <= match_end)
+        {
+                uint32_t sequence = codec_read32(src+ip);
+                uint32_t* slot = table+codec_hash(sequence);
+                size_t ref = *slot;
+                *slot = (uint32_t)ip;
+
+                if (ref >= ip || ip-ref > CODEC_MAX_OFFSET || codec_read32(src+ref) != sequence)
+                {
+                        ip += 1+((ip-anchor) >> CODEC_SKIP_SHIFT);
+                        continue;
+                }
+
+                while (ip > anchor && ref > 0 && src[ip-1] == src[ref-1])
+                {
+                        ip--;
+                        ref--;
+                }
+
+                size_t match_length = CODEC_MIN_MATCH;
+                while (ip+match_length+8 <= match_end)
+                {
+                        uint64_t difference = codec_read64(src+ip+match_length) ^ codec_read64(src+ref+match_length);
+                        if (difference != 0)
+                        {
+                                match_length += __builtin_ctzll(difference) >> 3;
+                                goto matched;
+                        }
+                        match_length += 8;
+                }
+                while (ip+match_length < match_end && src[ip+match_length] == src[ref+match_length])
+                        match_length++;
+matched:
+                op = codec_write_sequence(op, src+anchor, ip-anchor, ip-ref, match_length);
+                ip += match_length;
+                anchor = ip;
+
+                // seed the table inside the match so the next run of the same pattern is found
+                if (ip >= 2 && ip-2+CODEC_MIN_MATCH <= length)
+                        table[codec_hash(codec_read32(src+ip-2))] = (uint32_t)(ip-2);
+        }
+
+        op = codec_write_last_literals(op, src+anchor, length-anchor);
+
+        free(table);
+        return op-out;
+}
+
+
+size_t codec_decompressed_size(const unsigned char* in, size_t length)
+{
+        if (length < CODEC_HEADER_SIZE)
+                return 0;
+        return (size_t)in[0] | ((size_t)in[1] << 8) | ((size_t)in[2] << 16) | ((size_t)in[3] << 24);
+}
+
+
+static int codec_read_length(const unsigned char** ip, const unsigned char* end, size_t* length)
+{
+        unsigned char value;
+        do
+        {
+                if (*ip >= end)
+                        return -1;
+                value = *(*ip)++;
+                *length += value;
+        } while (value == 255);
+        return 0;
+}
+
+
+// copies a match of match_length bytes starting offset bytes back, out_end bounds the wide copies
+static inline void codec_copy_match(unsigned char* op, size_t offset, size_t match_length, unsigned char* out_end)
+{
+        const unsigned char* match = op-offset;
+        unsigned char* match_end = op+match_length;
+        if (offset == 1)
+        {
+                memset(op, *match, match_length);
+        }
+        else if (offset >= 16 && out_end-match_end >= 16)
+        {
+                // copies may run past the match, the tail is overwritten by what follows
+                for ( ; op < match_end ; op += 16, match += 16)
+                        codec_copy16(op, match);
+        }
+        else if (offset < 16 && match_length >= 16 && out_end-match_end >= 8)
+        {
+                // a short offset repeats a pattern, copying whole periods first lets the
+                // rest go 8 bytes at a time from at least 8 bytes back
+                size_t period = offset >= 8 ? offset : offset*((8+offset-1)/offset);
+                unsigned char* period_end = op+period;
+                for ( ; op < period_end ; op++, match++)
+                        *op = *match;
+                match = op-period;
+                for ( ; op < match_end ; op += 8, match += 8)
+                        codec_copy8(op, match);
+        }
+        else
+        {
+                for ( ; op < match_end ; op++, match++)
+                        *op = *match;
+        }
+}
+
+
+int codec_decompress(const unsigned char* in, size_t length, unsigned char* out, size_t out_length)
+{
+        if (codec_decompressed_size(in, length) != out_length || (length == CODEC_HEADER_SIZE && out_length != 0))
+                return -1;
+        if (length == CODEC_HEADER_SIZE)
+                return 0;
+
+        const unsigned char* ip = in+CODEC_HEADER_SIZE;
+        const unsigned char* in_end = in+length;
+        unsigned char* op = out;
+        unsigned char* out_end = out+out_length;
+
+        while (true)
+        {
+                if (ip >= in_end)
+                        return -1;
+                unsigned int token = *ip++;
+
+                size_t literal_length = token >> 4;
+                size_t match_length = token & 15;
+
+                // short literals and a short match, the common case for voxel data, is done
+                // with fixed size copies and without most of the checks of the general path
+                if (literal_length < 15 && match_length < 15 && in_end-ip >= 32 && out_end-op >= 48)
+                {
+                        codec_copy16(op, ip);
+                        ip += literal_length;
+                        op += literal_length;
+
+                        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+                        ip += 2;
+                        if (offset == 0 || offset > (size_t)(op-out))
+                                return -1;
+                        match_length += CODEC_MIN_MATCH;
+                        if (offset >= 16)
+                        {
+                                codec_copy16(op, op-offset);
+                                codec_copy8(op+16, op+16-offset);
+                        }
+                        else
+                        {
+                                codec_copy_match(op, offset, match_length, out_end);
+                        }
+                        op += match_length;
+                        continue;
+                }
+
+                if (literal_length == 15 && codec_read_length(&ip, in_end, &literal_length) != 0)
+                        return -1;
+                if (literal_length > (size_t)(in_end-ip) || literal_length > (size_t)(out_end-op))
+                        return -1;
+                memcpy(op, ip, literal_length);
+                ip += literal_length;
+                op += literal_length;
+
+                if (ip == in_end)
+                        break;
+
+                if (in_end-ip < 2)
+                        return -1;
+                size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+                ip += 2;
+                if (offset == 0 || offset > (size_t)(op-out))
+                        return -1;
+
+                if (match_length == 15 && codec_read_length(&ip, in_end, &match_length) != 0)
+                        return -1;
+                match_length += CODEC_MIN_MATCH;
+                if (match_length > (size_t)(out_end-op))
+                        return -1;
+
+                codec_copy_match(op, offset, match_length, out_end);
+                op += match_length;
+        }
+
+        if (op != out_end)
+                return -1;
+        return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// LZ77 codec tuned for voxel payloads (packed palette indices, rle runs).
+//
+// A stream is a 4 byte header holding the raw length followed by LZ4 style sequences:
+// a token byte holding the literal length in the high nibble and match length-4 in the
+// low nibble, 255 continued length bytes for either nibble when it is 15, the literals and
+// a 16 bit little endian match offset. The last sequence is literals only.
+//
+// Runs of the same palette word are matches at a short offset.
+//
+// Decoding never reads or writes outside the given buffers, corrupt input fails with -1.
+
+#define CODEC_HEADER_SIZE 4
+
+// worst case compressed size of length bytes
+size_t codec_compress_bound(size_t length);
+
+// compresses length bytes of in into out, which has to hold codec_compress_bound(length) bytes
+// returns the compressed size or 0 if length doesn't fit the header
+size_t codec_compress(const unsigned char* in, size_t length, unsigned char* out);
+
+// raw length stored in a compressed stream, 0 if the header is invalid
+size_t codec_decompressed_size(const unsigned char* in, size_t length);
+
+// decompresses into out, which has to be exactly the raw length, returns -1 on corrupt input
+int codec_decompress(const unsigned char* in, size_t length, unsigned char* out, size_t out_length);
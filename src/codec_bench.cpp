@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "chunk.h"
+#include "codec.h"
+
+// throughput of the voxel codec on serialized chunks, run from a release build
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+        return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+
+// stone, dirt and grass layers under a bumpy height field with air above
+static void generate_terrain_chunk(struct Chunk* chunk)
+{
+        struct Voxel stone = {0.5f, 0.5f, 0.5f, 1.0f, 0};
+        struct Voxel dirt = {0.4f, 0.25f, 0.1f, 1.0f, 0};
+        struct Voxel grass = {0.2f, 0.7f, 0.2f, 1.0f, 0};
+        int types[3] = {chunk_palette_index(chunk, stone), chunk_palette_index(chunk, dirt), chunk_palette_index(chunk, grass)};
+
+        for (int z = 0 ; z < chunk->size ; z++)
+        {
+                for (int x = 0 ; x < chunk->size ; x++)
+                {
+                        int height = chunk->size/2 + (x*7+z*13)%9 - 4 + rand()%2;
+                        for (int y = 0 ; y < height && y < chunk->size ; y++)
+                                chunk_set_index(chunk, x, y, z, y < height-4 ? types[0] : (y < height-1 ? types[1] : types[2]));
+                }
+        }
+}
+
+
+static void generate_noise_chunk(struct Chunk* chunk)
+{
+        struct Voxel purple = {0xDF/255.0f, 0.0f, 1.0f, 1.0f, 0};
+        struct Voxel magenta = {1.0f, 0.0f, 1.0f, 1.0f, 0};
+        int types[3] = {0, chunk_palette_index(chunk, purple), chunk_palette_index(chunk, magenta)};
+
+        for (int z = 0 ; z < chunk->size ; z++)
+        {
+                for (int y = 0 ; y < chunk->size ; y++)
+                {
+                        for (int x = 0 ; x < chunk->size ; x++)
+                                chunk_set_index(chunk, x, y, z, types[rand()%3]);
+                }
+        }
+}
+
+
+static void bench(const char* name, const unsigned char* data, size_t length, int iterations)
+{
+        unsigned char* compressed = (unsigned char*) malloc(codec_compress_bound(length));
+        unsigned char* decompressed = (unsigned char*) malloc(length);
+        if (compressed == NULL || decompressed == NULL)
+        {
+                printf("Unable to allocate the benchmark buffers.\n");
+                free(compressed);
+                free(decompressed);
+                return;
+        }
+
+        size_t compressed_size = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0 ; i < iterations ; i++)
+                compressed_size = codec_compress(data, length, compressed);
+        double compress_time = seconds_since(start);
+
+        int status = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0 ; i < iterations ; i++)
+                status |= codec_decompress(compressed, compressed_size, decompressed, length);
+        double decompress_time = seconds_since(start);
+
+        bool valid = status == 0 && memcmp(data, decompressed, length) == 0;
+        double megabytes = (double)length*iterations/(1024.0*1024.0);
+        printf("%-8s %9zu -> %9zu bytes (%6.2f%%) compress %8.1f MB/s decompress %8.1f MB/s %s\n",
+               name, length, compressed_size, 100.0*compressed_size/length,
+               megabytes/compress_time, megabytes/decompress_time, valid ? "" : "ROUND TRIP FAILED");
+
+        free(compressed);
+        free(decompressed);
+}
+
+
+int main(int argc, char* argv[])
+{
+        int size = argc > 1 ? atoi(argv[1]) : 64;
+        int iterations = argc > 2 ? atoi(argv[2]) : 50;
+        if (size <= 0 || iterations <= 0)
+        {
+                printf("usage: %s [chunk size] [iterations]\n",argv[0]);
+                return 1;
+        }
+
+        struct Voxel air = {0.0f, 0.0f, 0.0f, 0.0f, 0};
+        void (*generators[2])(struct Chunk*) = {generate_terrain_chunk, generate_noise_chunk};
+        const char* names[2] = {"terrain", "noise"};
+
+        for (int g = 0 ; g < 2 ; g++)
+        {
+                struct Chunk chunk = create_chunk(size, air);
+                if (chunk.data == NULL)
+                        return 1;
+                generators[g](&chunk);
+
+                size_t length = chunk_serialized_size(&chunk);
+                unsigned char* serialized = (unsigned char*) malloc(length);
+                if (serialized == NULL)
+                {
+                        free_chunk(&chunk);
+                        return 1;
+                }
+                chunk_serialize(&chunk, serialized);
+
+                bench(names[g], serialized, length, iterations);
+
+                free(serialized);
+                free_chunk(&chunk);
+        }
+
+        return 0;
+}
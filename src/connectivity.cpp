@@ -0,0 +1,104 @@
+#include "connectivity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+
+// EXPOSURE_* style bits of the chunk faces voxel (x, y, z) lies on
+static inline unsigned char connectivity_border_faces(int size, int x, int y, int z)
+{
+        unsigned char faces = 0;
+        faces |= (x == 0) << CHUNK_FACE_NEGATIVE_X;
+        faces |= (x == size-1) << CHUNK_FACE_POSITIVE_X;
+        faces |= (y == 0) << CHUNK_FACE_NEGATIVE_Y;
+        faces |= (y == size-1) << CHUNK_FACE_POSITIVE_Y;
+        faces |= (z == 0) << CHUNK_FACE_NEGATIVE_Z;
+        faces |= (z == size-1) << CHUNK_FACE_POSITIVE_Z;
+        return faces;
+}
+
+
+struct ChunkConnectivity connectivity_from_solid_mask(const struct SolidMask* mask, std::vector<int>* stack)
+{
+        struct ChunkConnectivity result;
+        memset(result.faces, 0, sizeof(result.faces));
+
+        if (mask->bits == NULL)
+        {
+                memset(result.faces, (1 << CHUNK_FACE_COUNT)-1, sizeof(result.faces));
+                return result;
+        }
+
+        int size = mask->size;
+        int words = mask->words_per_row;
+        size_t word_count = (size_t)words*size*size;
+
+        // solid voxels start out visited, so every air region is filled once
+        uint64_t* visited = (uint64_t*) malloc(word_count*sizeof(uint64_t));
+        if (visited == NULL)
+        {
+                printf("Unable to allocate the connectivity flood fill mask.\n");
+                memset(result.faces, (1 << CHUNK_FACE_COUNT)-1, sizeof(result.faces));
+                return result;
+        }
+        memcpy(visited, mask->bits, word_count*sizeof(uint64_t));
+        // padding past x = size-1 never counts as air
+        if (size%64 != 0)
+        {
+                uint64_t padding = ~0ull << (size%64);
+                for (size_t row = 0 ; row < (size_t)size*size ; row++)
+                        visited[row*words+words-1] |= padding;
+        }
+
+        for (size_t w = 0 ; w < word_count ; w++)
+        {
+                // whole words of solid or already filled voxels are skipped at once
+                while (visited[w] != ~0ull)
+                {
+                        int bit = __builtin_ctzll(~visited[w]);
+                        int row = w/words;
+                        int x = (w%words)*64+bit;
+                        visited[w] |= 1ull << bit;
+
+                        unsigned char touched = 0;
+                        stack->clear();
+                        stack->push_back((row*size)+x);
+                        while (!stack->empty())
+                        {
+                                int voxel = stack->back();
+                                stack->pop_back();
+                                int vx = voxel%size;
+                                int vy = (voxel/size)%size;
+                                int vz = voxel/(size*size);
+                                touched |= connectivity_border_faces(size, vx, vy, vz);
+
+                                int neighbours[6][3] = {{vx-1, vy, vz}, {vx+1, vy, vz}, {vx, vy-1, vz}, {vx, vy+1, vz}, {vx, vy, vz-1}, {vx, vy, vz+1}};
+                                for (int i = 0 ; i < 6 ; i++)
+                                {
+                                        int nx = neighbours[i][0], ny = neighbours[i][1], nz = neighbours[i][2];
+                                        if (nx < 0 || ny < 0 || nz < 0 || nx >= size || ny >= size || nz >= size)
+                                                continue;
+                                        uint64_t* word = visited+((size_t)nz*size+ny)*words+nx/64;
+                                        uint64_t bit_mask = 1ull << (nx%64);
+                                        if (*word & bit_mask)
+                                                continue;
+                                        *word |= bit_mask;
+                                        stack->push_back((nz*size+ny)*size+nx);
+                                }
+                        }
+
+                        // every face the region reaches sees every other one through it
+                        for (int face = 0 ; face < CHUNK_FACE_COUNT ; face++)
+                        {
+                                if ((touched >> face) & 1)
+                                        result.faces[face] |= touched;
+                        }
+                }
+        }
+
+        free(visited);
+        return result;
+}
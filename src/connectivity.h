@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <vector>
+
+#include "exposure.h"
+
+// faces of a chunk along the texture (and chunk coordinate) axes, in the order of the EXPOSURE_* bits.
+// The opposite of face f is f^1.
+enum ChunkFace
+{
+        CHUNK_FACE_NEGATIVE_X,
+        CHUNK_FACE_POSITIVE_X,
+        CHUNK_FACE_NEGATIVE_Y,
+        CHUNK_FACE_POSITIVE_Y,
+        CHUNK_FACE_NEGATIVE_Z,
+        CHUNK_FACE_POSITIVE_Z,
+        CHUNK_FACE_COUNT
+};
+
+
+// Which faces of a chunk are joined by air inside it, faces[f] has bit g set when a path
+// through voxels that aren't solid runs from face f to face g. A face with air on it is joined to itself.
+typedef struct ChunkConnectivity
+{
+        unsigned char faces[CHUNK_FACE_COUNT];
+}ChunkConnectivity;
+
+
+// flood fills the air of mask, a mask without bits counts as all air,
+// stack is scratch space the caller keeps around between fills
+struct ChunkConnectivity connectivity_from_solid_mask(const struct SolidMask* mask, std::vector<int>* stack);
+
+static inline bool connectivity_joins(const struct ChunkConnectivity* connectivity, int from, int to)
+{
+        return (connectivity->faces[from] >> to) & 1;
+}
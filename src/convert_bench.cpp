@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "chunk.h"
+#include "thread_pool.h"
+#include "voxel_convert.h"
+
+// voxels per second of the chunk to RGBA conversion kernels, run from a release build
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+        return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+
+// the demo's random noise of 3 block types, plus extra types to widen the indices
+static void generate_noise_chunk(struct Chunk* chunk, int types)
+{
+        int indices[256] = {0};
+        for (int i = 1 ; i < types ; i++)
+        {
+                struct Voxel voxel = {i/(float)types, 0.0f, 1.0f, 1.0f, i};
+                indices[i] = chunk_palette_index(chunk, voxel);
+        }
+
+        for (int z = 0 ; z < chunk->size ; z++)
+        {
+                for (int y = 0 ; y < chunk->size ; y++)
+                {
+                        for (int x = 0 ; x < chunk->size ; x++)
+                                chunk_set_index(chunk, x, y, z, indices[rand()%types]);
+                }
+        }
+}
+
+
+static void report(const char* name, const struct Chunk* chunk, double seconds, int iterations, const unsigned char* out, const unsigned char* reference)
+{
+        double voxels = (double)chunk->size*chunk->size*chunk->size*iterations;
+        size_t length = (size_t)chunk->size*chunk->size*chunk->size*4;
+        printf("  %-22s %8.2f ms %10.1f Mvoxels/s %s\n", name, seconds*1000.0/iterations, voxels/seconds/1e6,
+               memcmp(out, reference, length) == 0 ? "" : "MISMATCH");
+}
+
+
+int main(int argc, char* argv[])
+{
+        int size = argc > 1 ? atoi(argv[1]) : 256;
+        int iterations = argc > 2 ? atoi(argv[2]) : 10;
+        if (size <= 0 || iterations <= 0)
+        {
+                printf("usage: %s [chunk size] [iterations]\n",argv[0]);
+                return 1;
+        }
+
+        // a third argument overrides the worker count
+        struct ThreadPool* pool = create_thread_pool(argc > 3 ? atoi(argv[3]) : -1);
+        printf("best kernel: %s, %zu worker threads\n", convert_kernel_name(convert_best_kernel()), pool->threads.size());
+
+        size_t length = (size_t)size*size*size*4;
+        unsigned char* reference = (unsigned char*) malloc(length);
+        unsigned char* out = (unsigned char*) malloc(length);
+        if (reference == NULL || out == NULL)
+        {
+                printf("Unable to allocate the benchmark buffers.\n");
+                return 1;
+        }
+
+        int type_counts[4] = {2, 3, 16, 200};
+        for (int t = 0 ; t < 4 ; t++)
+        {
+                struct Voxel air = {0.0f, 0.0f, 0.0f, 0.0f, 0};
+                struct Chunk chunk = create_chunk(size, air);
+                if (chunk.data == NULL)
+                        return 1;
+                generate_noise_chunk(&chunk, type_counts[t]);
+                printf("%d^3 chunk, %d block types, %d bits per voxel\n", size, type_counts[t], chunk.bits);
+
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0 ; i < iterations ; i++)
+                        chunk_to_rgba(&chunk, reference);
+                report("chunk_to_rgba", &chunk, seconds_since(start), iterations, reference, reference);
+
+                size_t colour_count = ((size_t)1 << chunk.bits) < 8 ? 8 : (size_t)1 << chunk.bits;
+                uint32_t* colours = (uint32_t*) calloc(colour_count, sizeof(uint32_t));
+                for (int i = 0 ; i < chunk.palette_size ; i++)
+                        colours[i] = voxel_to_rgba(chunk.palette[i]);
+
+                enum ConvertKernel kernels[3] = {CONVERT_KERNEL_SCALAR, CONVERT_KERNEL_SSSE3, CONVERT_KERNEL_AVX2};
+                for (int k = 0 ; k < 3 ; k++)
+                {
+                        if (kernels[k] > convert_best_kernel())
+                                continue;
+                        memset(out, 0, length);
+                        start = std::chrono::steady_clock::now();
+                        for (int i = 0 ; i < iterations ; i++)
+                                convert_packed_to_rgba(kernels[k], chunk.data, chunk.bits, 0, (size_t)size*size*size, colours, chunk.palette_size, out);
+                        char name[64];
+                        snprintf(name, sizeof(name), "%s, 1 thread", convert_kernel_name(kernels[k]));
+                        report(name, &chunk, seconds_since(start), iterations, out, reference);
+                }
+
+                memset(out, 0, length);
+                start = std::chrono::steady_clock::now();
+                for (int i = 0 ; i < iterations ; i++)
+                        convert_chunk_to_rgba(&chunk, out, pool);
+                report("convert_chunk_to_rgba", &chunk, seconds_since(start), iterations, out, reference);
+
+                free(colours);
+                free_chunk(&chunk);
+        }
+
+        free(reference);
+        free(out);
+        free_thread_pool(pool);
+        return 0;
+}
@@ -0,0 +1,189 @@
+#include "dirty_bricks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static size_t dirty_bricks_word_count(int bricks)
+{
+        return ((size_t)bricks*bricks*bricks+63)/64;
+}
+
+
+static inline int dirty_bricks_test(const uint64_t* bits, size_t i)
+{
+        return (int)((bits[i/64] >> (i%64)) & 1);
+}
+
+
+static inline void dirty_bricks_set(uint64_t* bits, size_t i)
+{
+        bits[i/64] |= 1ull << (i%64);
+}
+
+
+static inline void dirty_bricks_reset(uint64_t* bits, size_t i)
+{
+        bits[i/64] &= ~(1ull << (i%64));
+}
+
+
+struct DirtyBricks create_dirty_bricks(int chunk_size)
+{
+        struct DirtyBricks result;
+
+        result.size = chunk_size;
+        result.bricks = (chunk_size+DIRTY_BRICK_SIZE-1)/DIRTY_BRICK_SIZE;
+        result.count = 0;
+        result.bits = (uint64_t*) calloc(dirty_bricks_word_count(result.bricks), sizeof(uint64_t));
+        if (result.bits == NULL)
+                printf("Unable to allocate the dirty bricks of a chunk of size %d.\n",chunk_size);
+
+        return result;
+}
+
+
+void free_dirty_bricks(struct DirtyBricks* dirty)
+{
+        free(dirty->bits);
+        dirty->bits = NULL;
+        dirty->count = 0;
+}
+
+
+void dirty_bricks_mark_voxel(struct DirtyBricks* dirty, int x, int y, int z)
+{
+        if (dirty->bits == NULL)
+                return;
+        size_t i = x/DIRTY_BRICK_SIZE + (size_t)dirty->bricks*(y/DIRTY_BRICK_SIZE + (size_t)dirty->bricks*(z/DIRTY_BRICK_SIZE));
+        if (!dirty_bricks_test(dirty->bits, i))
+        {
+                dirty_bricks_set(dirty->bits, i);
+                dirty->count++;
+        }
+}
+
+
+void dirty_bricks_mark_all(struct DirtyBricks* dirty)
+{
+        if (dirty->bits == NULL)
+                return;
+        size_t brick_count = (size_t)dirty->bricks*dirty->bricks*dirty->bricks;
+        for (size_t i = 0 ; i < brick_count ; i++)
+                dirty_bricks_set(dirty->bits, i);
+        dirty->count = brick_count;
+}
+
+
+void dirty_bricks_clear(struct DirtyBricks* dirty)
+{
+        if (dirty->bits == NULL)
+                return;
+        memset(dirty->bits, 0, dirty_bricks_word_count(dirty->bricks)*sizeof(uint64_t));
+        dirty->count = 0;
+}
+
+
+static struct DirtyBox dirty_brick_box(const struct DirtyBricks* dirty, int x0, int y0, int z0, int x1, int y1, int z1)
+{
+        struct DirtyBox result;
+        result.x = x0*DIRTY_BRICK_SIZE;
+        result.y = y0*DIRTY_BRICK_SIZE;
+        result.z = z0*DIRTY_BRICK_SIZE;
+        result.width = (x1*DIRTY_BRICK_SIZE < dirty->size ? x1*DIRTY_BRICK_SIZE : dirty->size)-result.x;
+        result.height = (y1*DIRTY_BRICK_SIZE < dirty->size ? y1*DIRTY_BRICK_SIZE : dirty->size)-result.y;
+        result.depth = (z1*DIRTY_BRICK_SIZE < dirty->size ? z1*DIRTY_BRICK_SIZE : dirty->size)-result.z;
+        return result;
+}
+
+
+int dirty_bricks_coalesce(const struct DirtyBricks* dirty, struct DirtyBox* out, int max_boxes)
+{
+        if (dirty->bits == NULL || dirty->count == 0 || max_boxes <= 0)
+                return 0;
+
+        int n = dirty->bricks;
+        size_t word_count = dirty_bricks_word_count(n);
+        // bricks still waiting for a box, taken ones are cleared as boxes grow over them
+        uint64_t* pending = (uint64_t*) malloc(word_count*sizeof(uint64_t));
+        if (pending == NULL)
+        {
+                printf("Unable to allocate the dirty brick scratch bits.\n");
+                *out = dirty_brick_box(dirty, 0, 0, 0, n, n, n);
+                return 1;
+        }
+        memcpy(pending, dirty->bits, word_count*sizeof(uint64_t));
+
+        int count = 0;
+        int min_x = n, min_y = n, min_z = n, max_x = 0, max_y = 0, max_z = 0;
+        for (size_t w = 0 ; w < word_count ; w++)
+        {
+                while (pending[w] != 0)
+                {
+                        size_t start = w*64 + __builtin_ctzll(pending[w]);
+                        int x0 = start%n;
+                        int y0 = (start/n)%n;
+                        int z0 = start/((size_t)n*n);
+
+                        int x1 = x0+1;
+                        while (x1 < n && dirty_bricks_test(pending, start+(x1-x0)))
+                                x1++;
+
+                        int y1 = y0+1;
+                        for ( ; y1 < n ; y1++)
+                        {
+                                size_t row = x0 + (size_t)n*(y1 + (size_t)n*z0);
+                                int x = x0;
+                                while (x < x1 && dirty_bricks_test(pending, row+(x-x0)))
+                                        x++;
+                                if (x != x1)
+                                        break;
+                        }
+
+                        int z1 = z0+1;
+                        for ( ; z1 < n ; z1++)
+                        {
+                                bool full = true;
+                                for (int y = y0 ; y < y1 && full ; y++)
+                                {
+                                        size_t row = x0 + (size_t)n*(y + (size_t)n*z1);
+                                        for (int x = x0 ; x < x1 && full ; x++)
+                                                full = dirty_bricks_test(pending, row+(x-x0));
+                                }
+                                if (!full)
+                                        break;
+                        }
+
+                        for (int z = z0 ; z < z1 ; z++)
+                        {
+                                for (int y = y0 ; y < y1 ; y++)
+                                {
+                                        size_t row = x0 + (size_t)n*(y + (size_t)n*z);
+                                        for (int x = x0 ; x < x1 ; x++)
+                                                dirty_bricks_reset(pending, row+(x-x0));
+                                }
+                        }
+
+                        if (count < max_boxes)
+                                out[count] = dirty_brick_box(dirty, x0, y0, z0, x1, y1, z1);
+                        count++;
+
+                        min_x = x0 < min_x ? x0 : min_x;
+                        min_y = y0 < min_y ? y0 : min_y;
+                        min_z = z0 < min_z ? z0 : min_z;
+                        max_x = x1 > max_x ? x1 : max_x;
+                        max_y = y1 > max_y ? y1 : max_y;
+                        max_z = z1 > max_z ? z1 : max_z;
+                }
+        }
+
+        free(pending);
+
+        if (count > max_boxes)
+        {
+                *out = dirty_brick_box(dirty, min_x, min_y, min_z, max_x, max_y, max_z);
+                return 1;
+        }
+        return count;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// edge length in voxels of the bricks edits are tracked in, one brick of RGBA8 texels is 256 bytes
+#define DIRTY_BRICK_SIZE 4
+
+
+// box of voxels to upload, in voxels and always brick aligned (clamped to the chunk)
+typedef struct DirtyBox
+{
+        int x, y, z;
+        int width, height, depth;
+}DirtyBox;
+
+
+// One bit per DIRTY_BRICK_SIZE^3 brick of a chunk, bricks are addressed x fastest like voxels.
+// Edits mark the bricks they touch and the uploader turns the marked bricks into a few boxes
+// so a changed voxel costs one brick of upload instead of the whole chunk texture.
+typedef struct DirtyBricks
+{
+        // chunk size in voxels
+        int size;
+        // bricks along each axis
+        int bricks;
+        uint64_t* bits;
+        // number of marked bricks
+        int count;
+}DirtyBricks;
+
+
+struct DirtyBricks create_dirty_bricks(int chunk_size);
+void free_dirty_bricks(struct DirtyBricks* dirty);
+
+void dirty_bricks_mark_voxel(struct DirtyBricks* dirty, int x, int y, int z);
+void dirty_bricks_mark_all(struct DirtyBricks* dirty);
+void dirty_bricks_clear(struct DirtyBricks* dirty);
+
+// greedily merges the marked bricks into boxes covering exactly those bricks, each box grows
+// along x, then y, then z for as long as every brick it would take in is marked.
+// writes at most max_boxes boxes and returns how many were written, the marks are left alone.
+// If they don't fit, a single box bounding every marked brick is written instead.
+int dirty_bricks_coalesce(const struct DirtyBricks* dirty, struct DirtyBox* out, int max_boxes);
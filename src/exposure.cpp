@@ -0,0 +1,110 @@
+#include "exposure.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct SolidMask create_solid_mask(int size)
+{
+        struct SolidMask result;
+
+        result.size = size;
+        result.words_per_row = (size+63)/64;
+        result.bits = (uint64_t*) calloc((size_t)result.words_per_row*size*size, sizeof(uint64_t));
+        if (result.bits == NULL)
+                printf("Unable to allocate a %d^3 solid mask.\n",size);
+
+        return result;
+}
+
+
+void free_solid_mask(struct SolidMask* mask)
+{
+        free(mask->bits);
+        mask->bits = NULL;
+}
+
+
+static inline const uint64_t* solid_mask_row(const struct SolidMask* mask, int y, int z)
+{
+        return mask->bits+((size_t)z*mask->size+y)*mask->words_per_row;
+}
+
+
+void solid_mask_set(struct SolidMask* mask, int x, int y, int z, bool solid)
+{
+        if (mask->bits == NULL)
+                return;
+
+        uint64_t* word = (uint64_t*)solid_mask_row(mask, y, z)+x/64;
+        if (solid)
+                *word |= 1ull << (x%64);
+        else
+                *word &= ~(1ull << (x%64));
+}
+
+
+bool solid_mask_get(const struct SolidMask* mask, int x, int y, int z)
+{
+        if (mask->bits == NULL)
+                return false;
+
+        return (*(solid_mask_row(mask, y, z)+x/64) >> (x%64)) & 1;
+}
+
+
+void exposure_from_solid_mask(const struct SolidMask* mask, const struct DirtyBox* box, unsigned char* out)
+{
+        if (mask->bits == NULL)
+        {
+                memset(out, 0, (size_t)box->width*box->height*box->depth);
+                return;
+        }
+
+        int size = mask->size;
+        int words = mask->words_per_row;
+
+        for (int z = box->z ; z < box->z+box->depth ; z++)
+        {
+                for (int y = box->y ; y < box->y+box->height ; y++)
+                {
+                        // rows past the chunk border count as air
+                        const uint64_t* row = solid_mask_row(mask, y, z);
+                        const uint64_t* below = y > 0 ? solid_mask_row(mask, y-1, z) : NULL;
+                        const uint64_t* above = y < size-1 ? solid_mask_row(mask, y+1, z) : NULL;
+                        const uint64_t* behind = z > 0 ? solid_mask_row(mask, y, z-1) : NULL;
+                        const uint64_t* ahead = z < size-1 ? solid_mask_row(mask, y, z+1) : NULL;
+
+                        for (int w = box->x/64 ; w <= (box->x+box->width-1)/64 ; w++)
+                        {
+                                uint64_t solid = row[w];
+                                // neighbours at x-1 and x+1, carrying across words
+                                uint64_t left = solid << 1 | (w > 0 ? row[w-1] >> 63 : 0);
+                                uint64_t right = solid >> 1 | (w < words-1 ? row[w+1] << 63 : 0);
+
+                                uint64_t exposed[6];
+                                exposed[0] = solid & ~left;
+                                exposed[1] = solid & ~right;
+                                exposed[2] = solid & ~(below != NULL ? below[w] : 0);
+                                exposed[3] = solid & ~(above != NULL ? above[w] : 0);
+                                exposed[4] = solid & ~(behind != NULL ? behind[w] : 0);
+                                exposed[5] = solid & ~(ahead != NULL ? ahead[w] : 0);
+
+                                int from = box->x > w*64 ? box->x : w*64;
+                                int to = box->x+box->width < (w+1)*64 ? box->x+box->width : (w+1)*64;
+                                unsigned char* texel = out+(((size_t)(z-box->z)*box->height+(y-box->y))*box->width+(from-box->x));
+                                for (int x = from ; x < to ; x++)
+                                {
+                                        int bit = x%64;
+                                        *texel++ = (unsigned char)(((exposed[0] >> bit) & 1)
+                                                                   | ((exposed[1] >> bit) & 1) << 1
+                                                                   | ((exposed[2] >> bit) & 1) << 2
+                                                                   | ((exposed[3] >> bit) & 1) << 3
+                                                                   | ((exposed[4] >> bit) & 1) << 4
+                                                                   | ((exposed[5] >> bit) & 1) << 5);
+                                }
+                        }
+                }
+        }
+}
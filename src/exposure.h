@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "dirty_bricks.h"
+
+// bits of an exposure texel, set when the voxel is solid and its neighbour
+// that way along the texture axes is not (or lies outside the chunk)
+#define EXPOSURE_NEGATIVE_X 1
+#define EXPOSURE_POSITIVE_X 2
+#define EXPOSURE_NEGATIVE_Y 4
+#define EXPOSURE_POSITIVE_Y 8
+#define EXPOSURE_NEGATIVE_Z 16
+#define EXPOSURE_POSITIVE_Z 32
+
+
+// One bit per voxel of a chunk, rows along x are padded to whole words so the
+// neighbours along every axis are a shift or a word of another row away.
+typedef struct SolidMask
+{
+        int size;
+        int words_per_row;
+        uint64_t* bits;
+}SolidMask;
+
+
+struct SolidMask create_solid_mask(int size);
+void free_solid_mask(struct SolidMask* mask);
+
+void solid_mask_set(struct SolidMask* mask, int x, int y, int z, bool solid);
+bool solid_mask_get(const struct SolidMask* mask, int x, int y, int z);
+
+// writes the exposure bits of every voxel of box to out, one byte per voxel, x fastest.
+// 64 voxels of a row are worked out at once from the rows around them.
+void exposure_from_solid_mask(const struct SolidMask* mask, const struct DirtyBox* box, unsigned char* out);
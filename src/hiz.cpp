@@ -0,0 +1,151 @@
+#include "hiz.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glad/gl.h>
+
+#include "shader.h"
+
+// invocations per side of a reduction work group, matching hizReduce.glsl
+#define HIZ_GROUP_SIZE 8
+
+
+struct HiZ create_hiz(const char* reducePath, const char* reprojectPath)
+{
+        struct HiZ result;
+
+        result.depth_texture = 0;
+        result.reprojected = 0;
+        result.pyramid = 0;
+        result.reduce_program = load_compute_shader(reducePath);
+        result.reproject_program = load_compute_shader(reprojectPath);
+        result.width = 0;
+        result.height = 0;
+        result.levels = 0;
+        result.view_projection = glm::mat4(1.0f);
+        result.pyramid_view_projection = glm::mat4(1.0f);
+        result.valid = false;
+
+        return result;
+}
+
+
+static void hiz_free_textures(struct HiZ* hiz)
+{
+        if (hiz->depth_texture != 0)
+                glDeleteTextures(1, &hiz->depth_texture);
+        if (hiz->reprojected != 0)
+                glDeleteTextures(1, &hiz->reprojected);
+        if (hiz->pyramid != 0)
+                glDeleteTextures(1, &hiz->pyramid);
+        hiz->depth_texture = 0;
+        hiz->reprojected = 0;
+        hiz->pyramid = 0;
+}
+
+
+void free_hiz(struct HiZ* hiz)
+{
+        hiz_free_textures(hiz);
+        glDeleteProgram(hiz->reduce_program);
+        glDeleteProgram(hiz->reproject_program);
+        hiz->valid = false;
+}
+
+
+// textures are immutable, a resized framebuffer gets new ones
+static void hiz_resize(struct HiZ* hiz, int width, int height)
+{
+        hiz_free_textures(hiz);
+        hiz->width = width;
+        hiz->height = height;
+        hiz->levels = 1;
+        while ((width >> hiz->levels) > 0 || (height >> hiz->levels) > 0)
+                hiz->levels++;
+
+        glGenTextures(1, &hiz->depth_texture);
+        glBindTexture(GL_TEXTURE_2D, hiz->depth_texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenTextures(1, &hiz->reprojected);
+        glBindTexture(GL_TEXTURE_2D, hiz->reprojected);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenTextures(1, &hiz->pyramid);
+        glBindTexture(GL_TEXTURE_2D, hiz->pyramid);
+        glTexStorage2D(GL_TEXTURE_2D, hiz->levels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void hiz_capture(struct HiZ* hiz, int width, int height, glm::mat4 view_projection)
+{
+        if (width <= 0 || height <= 0)
+                return;
+        if (width != hiz->width || height != hiz->height || hiz->pyramid == 0)
+                hiz_resize(hiz, width, height);
+
+        glBindTexture(GL_TEXTURE_2D, hiz->depth_texture);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        hiz->view_projection = view_projection;
+        hiz->valid = true;
+}
+
+
+void hiz_build(struct HiZ* hiz, glm::mat4 view_projection)
+{
+        if (!hiz->valid)
+                return;
+
+        // a still camera sees exactly the captured depth, anything else is reprojected first
+        bool reproject = view_projection != hiz->view_projection;
+        if (reproject)
+        {
+                unsigned int nothing = 0;
+                glClearTexImage(hiz->reprojected, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &nothing);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+                glUseProgram(hiz->reproject_program);
+                glBindTexture(GL_TEXTURE_2D, hiz->depth_texture);
+                set_shader_value_int("DEPTH", 0, hiz->reproject_program);
+                set_shader_value_matrix4("REPROJECTION", view_projection*glm::inverse(hiz->view_projection), hiz->reproject_program);
+                glBindImageTexture(0, hiz->reprojected, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+                glDispatchCompute((hiz->width+HIZ_GROUP_SIZE-1)/HIZ_GROUP_SIZE, (hiz->height+HIZ_GROUP_SIZE-1)/HIZ_GROUP_SIZE, 1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+
+        glUseProgram(hiz->reduce_program);
+        set_shader_value_int("SOURCE", 0, hiz->reduce_program);
+        set_shader_value_int("REPROJECTED_SOURCE", 1, hiz->reduce_program);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, hiz->reprojected);
+        glActiveTexture(GL_TEXTURE0);
+        for (int level = 0 ; level < hiz->levels ; level++)
+        {
+                // level 0 comes from the depth texture or its reprojection, every other level reduces the one before it
+                glBindTexture(GL_TEXTURE_2D, level == 0 ? hiz->depth_texture : hiz->pyramid);
+                set_shader_value_int("SOURCE_LEVEL", level == 0 ? 0 : level-1, hiz->reduce_program);
+                set_shader_value_int("COPY", level == 0, hiz->reduce_program);
+                set_shader_value_int("REPROJECTED", level == 0 && reproject, hiz->reduce_program);
+                glBindImageTexture(0, hiz->pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+                int level_width = hiz->width >> level > 0 ? hiz->width >> level : 1;
+                int level_height = hiz->height >> level > 0 ? hiz->height >> level : 1;
+                glDispatchCompute((level_width+HIZ_GROUP_SIZE-1)/HIZ_GROUP_SIZE, (level_height+HIZ_GROUP_SIZE-1)/HIZ_GROUP_SIZE, 1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        hiz->pyramid_view_projection = view_projection;
+}
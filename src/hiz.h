@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "glm/gtc/type_ptr.hpp"
+
+
+// Depth pyramid built from the depth of a drawn frame. Level 0 is the depth and every texel
+// of a further level holds the farthest depth of the texels it covers one level down,
+// the last row and column of an odd sized level fold into their neighbours so nothing is
+// dropped. A box whose nearest depth is behind the farthest depth of the few texels
+// covering its screen rectangle is hidden.
+// When the camera moved since the depth was captured, level 0 is the captured depth
+// reprojected into the new view instead. Pixels nothing lands on are left at the far plane,
+// so whatever was just uncovered is never hidden by depth that no longer lies in front of it.
+typedef struct HiZ
+{
+        // GL_DEPTH_COMPONENT32F copy of the default framebuffer's depth
+        unsigned int depth_texture;
+        // GL_R32UI farthest reprojected depth of every pixel as float bits, 0 where nothing landed
+        unsigned int reprojected;
+        // GL_R32F with a full mip chain
+        unsigned int pyramid;
+        unsigned int reduce_program;
+        unsigned int reproject_program;
+        int width;
+        int height;
+        int levels;
+        // projection*view the captured depth was drawn with
+        glm::mat4 view_projection;
+        // projection*view the pyramid was built for
+        glm::mat4 pyramid_view_projection;
+        // false until a frame has been captured
+        bool valid;
+}HiZ;
+
+
+struct HiZ create_hiz(const char* reducePath, const char* reprojectPath);
+void free_hiz(struct HiZ* hiz);
+
+// copies the depth buffer of the frame just drawn with view_projection,
+// width and height are the framebuffer size
+void hiz_capture(struct HiZ* hiz, int width, int height, glm::mat4 view_projection);
+// builds the pyramid of the captured depth as seen with view_projection, only valid hiz
+void hiz_build(struct HiZ* hiz, glm::mat4 view_projection);
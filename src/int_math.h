@@ -0,0 +1,11 @@
+#pragma once
+
+// value/divisor rounded towards negative infinity, so negative chunk and region
+// coordinates step down at the same boundaries as positive ones
+static inline int floor_divide(int value, int divisor)
+{
+        int quotient = value/divisor;
+        if (value%divisor != 0 && (value < 0) != (divisor < 0))
+                quotient--;
+        return quotient;
+}
@@ -0,0 +1,548 @@
+#include "lattice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include "shader.h"
+
+
+// the plane of layer L of a face sits at (slope*L+offset)*voxel_scale along the face's axis
+// and is front facing from the side of side, see create_lattice_mesh_data
+static const int face_axes[LATTICE_FACE_COUNT] = {2, 2, 0, 0, 1, 1};
+static const float face_slopes[LATTICE_FACE_COUNT] = {-1.0f, -1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+static const float face_offsets[LATTICE_FACE_COUNT] = {0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+static const float face_sides[LATTICE_FACE_COUNT] = {-1.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f};
+// the same for the shared planes of the z, x and y axes
+static const float plane_slopes[3] = {-1.0f, 1.0f, 1.0f};
+static const float plane_offsets[3] = {1.0f, 0.0f, 0.0f};
+
+
+void lattice_visible_layers(const struct Lattice* lattice, glm::vec3 position, int face, int* first, int* last)
+{
+        int size = lattice->width;
+        float scale = lattice->voxel_scale;
+        // side*(position-(slope*L+offset)*scale) > 0 solved for L
+        float bound = (position[face_axes[face]]/scale-face_offsets[face])/face_slopes[face];
+
+        if (face_sides[face]*face_slopes[face] > 0.0f)
+        {
+                // L < bound
+                *first = 0;
+                *last = (int) fminf(ceilf(bound), (float)size);
+        }
+        else
+        {
+                // L > bound
+                *first = (int) fmaxf(floorf(bound)+1.0f, 0.0f);
+                *last = size;
+        }
+
+        if (*last < *first)
+                *last = *first;
+        if (*first > size)
+                *first = *last = size;
+}
+
+
+bool lattice_frustum_bounds(const struct Lattice* lattice, glm::mat4 clip, glm::vec3* low, glm::vec3* high)
+{
+        double extent = (double)lattice->voxel_scale*lattice->width;
+        double scale = lattice->voxel_scale;
+
+        // half spaces n.x+d >= 0, the 6 frustum planes of clip followed by the 6 sides of the lattice
+        glm::dvec4 planes[12];
+        for (int i = 0 ; i < 3 ; i++)
+        {
+                glm::dvec4 row = glm::dvec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+                glm::dvec4 w = glm::dvec4(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+                planes[i*2] = w+row;
+                planes[i*2+1] = w-row;
+        }
+        // the mesh spans x and y in [0, extent] and z in [scale-extent, scale]
+        planes[6] = glm::dvec4(1, 0, 0, 0);
+        planes[7] = glm::dvec4(-1, 0, 0, extent);
+        planes[8] = glm::dvec4(0, 1, 0, 0);
+        planes[9] = glm::dvec4(0, -1, 0, extent);
+        planes[10] = glm::dvec4(0, 0, 1, extent-scale);
+        planes[11] = glm::dvec4(0, 0, -1, scale);
+        for (int i = 0 ; i < 12 ; i++)
+        {
+                double length = glm::length(glm::dvec3(planes[i]));
+                if (length > 0.0)
+                        planes[i] /= length;
+        }
+
+        // every vertex of the clipped lattice is where 3 of the planes meet inside all the others
+        double tolerance = scale*0.0001;
+        bool found = false;
+        glm::dvec3 lowest, highest;
+        for (int i = 0 ; i < 12 ; i++)
+        {
+                for (int j = i+1 ; j < 12 ; j++)
+                {
+                        for (int k = j+1 ; k < 12 ; k++)
+                        {
+                                glm::dvec3 a = glm::dvec3(planes[i]), b = glm::dvec3(planes[j]), c = glm::dvec3(planes[k]);
+                                double determinant = glm::dot(a, glm::cross(b, c));
+                                if (fabs(determinant) < 1e-9)
+                                        continue;
+                                glm::dvec3 point = (-planes[i].w*glm::cross(b, c) - planes[j].w*glm::cross(c, a) - planes[k].w*glm::cross(a, b))/determinant;
+
+                                bool inside = true;
+                                for (int p = 0 ; p < 12 && inside ; p++)
+                                        inside = glm::dot(glm::dvec3(planes[p]), point)+planes[p].w >= -tolerance;
+                                if (!inside)
+                                        continue;
+
+                                lowest = found ? glm::min(lowest, point) : point;
+                                highest = found ? glm::max(highest, point) : point;
+                                found = true;
+                        }
+                }
+        }
+
+        if (found)
+        {
+                *low = glm::vec3(lowest);
+                *high = glm::vec3(highest);
+        }
+        return found;
+}
+
+
+// narrows [first, last) to the layers whose plane, at (slope*L+offset)*scale, lies within [low, high]
+static void lattice_clip_layers(float slope, float offset, float scale, float low, float high, int* first, int* last)
+{
+        float from = (low/scale-offset)/slope;
+        float to = (high/scale-offset)/slope;
+        if (slope < 0.0f)
+        {
+                float swap = from;
+                from = to;
+                to = swap;
+        }
+
+        // a little slack so layers lying exactly on the bounds stay
+        int clipped_first = (int) ceilf(from-0.001f);
+        int clipped_last = (int) floorf(to+0.001f)+1;
+        if (clipped_first > *first)
+                *first = clipped_first;
+        if (clipped_last < *last)
+                *last = clipped_last;
+        if (*last < *first)
+                *last = *first;
+}
+
+
+// whether the voxels shown by layer of face group hold anything solid,
+// groups are the 6 faces or the 3 axes of shared planes
+static bool lattice_layer_occupied(const struct Lattice* lattice, int group, int layer)
+{
+        if (lattice->occupancy == NULL)
+                return true;
+
+        int size = lattice->width;
+        // texture axis of the z, x and y faces, x layers run against texture x
+        int axis = lattice->shared_planes ? face_axes[group*2] : face_axes[group];
+        const int* counts = lattice->occupancy+axis*size;
+
+        // a shared plane shows the layers on both of its sides, plane p lies between p-1 and p
+        int low = lattice->shared_planes ? layer-1 : layer;
+        for (int i = low ; i <= layer ; i++)
+        {
+                if (i < 0 || i >= size)
+                        continue;
+                if (counts[axis == 0 ? size-1-i : i] > 0)
+                        return true;
+        }
+        return false;
+}
+
+
+void lattice_occupied_layers(const struct Lattice* lattice, int group, int* first, int* last)
+{
+        int layers = lattice->shared_planes ? lattice->width+1 : lattice->width;
+        *first = 0;
+        *last = 0;
+        for (int layer = 0 ; layer < layers ; layer++)
+        {
+                if (!lattice_layer_occupied(lattice, group, layer))
+                        continue;
+                if (*last == 0)
+                        *first = layer;
+                *last = layer+1;
+        }
+}
+
+
+void lattice_bounds(const struct Lattice* lattice, glm::vec3* low, glm::vec3* high)
+{
+        float extent = lattice->voxel_scale*lattice->width;
+        float scale = lattice->voxel_scale;
+        for (int i = 0 ; i < 8 ; i++)
+        {
+                // the mesh spans x and y in [0, extent] and z in [scale-extent, scale]
+                glm::vec3 corner = glm::vec3(i&1 ? extent : 0.0f, i&2 ? extent : 0.0f, i&4 ? scale : scale-extent);
+                glm::vec3 point = glm::vec3(lattice->model_matrix*glm::vec4(corner, 1.0f));
+                *low = i == 0 ? point : glm::min(*low, point);
+                *high = i == 0 ? point : glm::max(*high, point);
+        }
+}
+
+
+// adds the occupied layers of [first, last) of face group to runs, nearest to the camera first when descending
+static void lattice_add_layers(const struct Lattice* lattice, int group, int first, int last, bool descending, struct LatticeRuns* runs)
+{
+        int layers = lattice->shared_planes ? lattice->width+1 : lattice->width;
+        int groups = lattice->shared_planes ? 3 : LATTICE_FACE_COUNT;
+
+        // walk positions in the order drawn, the reversed copy of every group follows the ascending ones
+        int position_first = descending ? layers-last : first;
+        int position_last = descending ? layers-first : last;
+        int base = descending ? groups*layers + group*layers : group*layers;
+
+        int run_start = -1;
+        for (int position = position_first ; position <= position_last ; position++)
+        {
+                bool occupied = false;
+                if (position < position_last)
+                        occupied = lattice_layer_occupied(lattice, group, descending ? layers-1-position : position);
+
+                if (occupied && run_start == -1)
+                {
+                        run_start = position;
+                }
+                else if (!occupied && run_start != -1)
+                {
+                        runs->firsts.push_back(base+run_start);
+                        runs->counts.push_back(position-run_start);
+                        run_start = -1;
+                }
+        }
+}
+
+
+void lattice_set_shape_uniforms(const struct Lattice* lattice, unsigned int shader_program)
+{
+        set_shader_value_int("LATTICE_SIZE", lattice->width, shader_program);
+        set_shader_value_float("VOXEL_SCALE", lattice->voxel_scale, shader_program);
+        set_shader_value_int("PROCEDURAL", lattice->vbo == 0, shader_program);
+        set_shader_value_int("SHARED_PLANES", lattice->shared_planes, shader_program);
+}
+
+
+// draws the gathered runs, 6 vertices or indices for every layer quad
+static void lattice_draw_runs(const struct Lattice* lattice, struct LatticeRuns* runs)
+{
+        int run_count = runs->firsts.size();
+        if (run_count == 0)
+                return;
+
+        for (int i = 0 ; i < run_count ; i++)
+        {
+                runs->firsts[i] *= 6;
+                runs->counts[i] *= 6;
+        }
+
+        if (lattice->vbo == 0)
+        {
+                glMultiDrawArrays(GL_TRIANGLES, runs->firsts.data(), runs->counts.data(), run_count);
+                return;
+        }
+
+        int index_bytes = lattice->index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+        runs->offsets.resize(run_count);
+        for (int i = 0 ; i < run_count ; i++)
+                runs->offsets[i] = (const void*)((size_t)runs->firsts[i]*index_bytes);
+        glMultiDrawElements(GL_TRIANGLES, runs->counts.data(), lattice->index_type, runs->offsets.data(), run_count);
+}
+
+
+int lattice_select_lod(const struct Lattice* lattice, glm::vec3 position)
+{
+        if (lattice->lod_count == 0)
+                return 0;
+
+        // distance to the nearest point of the lattice, in lattice widths
+        glm::vec3 low, high;
+        lattice_bounds(lattice, &low, &high);
+        float extent = lattice->voxel_scale*lattice->width;
+        float distance = glm::length(glm::max(glm::max(low-position, position-high), glm::vec3(0.0f)))/extent;
+
+        int level = lattice->lod;
+        while (level < lattice->lod_count && distance > lattice->lod_distance*(1 << level)*(1.0f+LATTICE_LOD_HYSTERESIS))
+                level++;
+        while (level > 0 && distance < lattice->lod_distance*(1 << (level-1))*(1.0f-LATTICE_LOD_HYSTERESIS))
+                level--;
+        return level;
+}
+
+
+void draw_lattice(GLFWwindow* window, struct Lattice* lattice, struct Camera* camera, struct LatticeRuns* runs)
+{
+        lattice->lod = lattice_select_lod(lattice, camera->position);
+        if (lattice->lod > 0)
+        {
+                draw_lattice(window, lattice->lods+lattice->lod-1, camera, runs);
+                return;
+        }
+
+        glBindVertexArray(lattice->vao);
+
+        if (lattice->texture != 0)
+                glBindTexture(GL_TEXTURE_3D, lattice->texture);
+        if (lattice->palette_buffer != 0)
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lattice->palette_buffer);
+        if (lattice->exposure != 0)
+        {
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_3D, lattice->exposure);
+                glActiveTexture(GL_TEXTURE0);
+        }
+        if (lattice->indirection != 0)
+        {
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_3D, lattice->indirection);
+                glActiveTexture(GL_TEXTURE0);
+        }
+
+        glUseProgram(lattice->shader_program);
+
+        set_shader_value_float("TIME", (float) glfwGetTime(), lattice->shader_program);
+
+        int width,height;
+        glfwGetWindowSize(window, &width, &height);
+        glm::vec2 resolution = glm::vec2(width, height);
+        set_shader_value_vec2("RESOLUTION", resolution, lattice->shader_program);
+        
+        camera->projection = glm::perspective(glm::radians(camera->fov), (float)width/height, 0.001f, 3000.0f);
+
+        set_shader_value_matrix4("model", lattice->model_matrix, lattice->shader_program);
+        set_shader_value_matrix4("view", camera->view, lattice->shader_program);
+        set_shader_value_matrix4("projection", camera->projection, lattice->shader_program);
+
+        lattice_set_shape_uniforms(lattice, lattice->shader_program);
+        set_shader_value_int("BATCHED", 0, lattice->shader_program);
+        set_shader_value_int("EXPOSURE", 1, lattice->shader_program);
+        set_shader_value_int("EXPOSURE_MASK", lattice->exposure != 0, lattice->shader_program);
+        set_shader_value_int("TEXTURE_LEVEL", lattice->texture_level, lattice->shader_program);
+        set_shader_value_ivec3("TEXTURE_ORIGIN", lattice->texture_origin, lattice->shader_program);
+        set_shader_value_int("INDIRECTION", 2, lattice->shader_program);
+        set_shader_value_int("BRICKED", lattice->indirection != 0, lattice->shader_program);
+
+        bool culling = glIsEnabled(GL_CULL_FACE);
+
+        runs->firsts.clear();
+        runs->counts.clear();
+        lattice_collect_runs(lattice, camera, culling, runs);
+
+        // both sides of a shared plane show a voxel
+        if (lattice->shared_planes && culling)
+                glDisable(GL_CULL_FACE);
+        lattice_draw_runs(lattice, runs);
+        if (lattice->shared_planes && culling)
+                glEnable(GL_CULL_FACE);
+}
+
+
+bool lattice_collect_runs(const struct Lattice* lattice, const struct Camera* camera, bool culling, struct LatticeRuns* runs)
+{
+        int size = lattice->width;
+        glm::vec3 position = glm::vec3(glm::inverse(lattice->model_matrix)*glm::vec4(camera->position, 1.0f));
+
+        // the slab of layers along every axis that reaches into the view frustum
+        glm::vec3 low, high;
+        if (!lattice_frustum_bounds(lattice, camera->projection*camera->view*lattice->model_matrix, &low, &high))
+                return false;
+
+        // Layers are drawn nearest first so the depth test rejects the texels they hide
+        // before the fragment shader runs.
+        if (lattice->shared_planes)
+        {
+                // none of the double sided planes can be skipped for facing away,
+                // planes below the camera go towards plane 0 and the rest away from it
+                for (int axis = 0 ; axis < 3 ; axis++)
+                {
+                        float camera_plane = (position[face_axes[axis*2]]/lattice->voxel_scale-plane_offsets[axis])/plane_slopes[axis];
+                        int split = (int) fminf(fmaxf(floorf(camera_plane)+1.0f, 0.0f), (float)(size+1));
+                        int first = 0;
+                        int last = size+1;
+                        int axis_index = face_axes[axis*2];
+                        lattice_clip_layers(plane_slopes[axis], plane_offsets[axis], lattice->voxel_scale, low[axis_index], high[axis_index], &first, &last);
+                        lattice_add_layers(lattice, axis, first, split < last ? split : last, true, runs);
+                        lattice_add_layers(lattice, axis, split > first ? split : first, last, false, runs);
+                }
+                return true;
+        }
+
+        // at most three faces are front facing from outside the lattice,
+        // from inside every face has a front facing range of layers
+        for (int face = 0 ; face < LATTICE_FACE_COUNT ; face++)
+        {
+                int first = 0;
+                int last = size;
+                if (culling)
+                        lattice_visible_layers(lattice, position, face, &first, &last);
+                int axis = face_axes[face];
+                lattice_clip_layers(face_slopes[face], face_offsets[face], lattice->voxel_scale, low[axis], high[axis], &first, &last);
+                // front facing layers lie between the camera and layer 0 when they are below the bound
+                bool descending = face_sides[face]*face_slopes[face] > 0.0f;
+                lattice_add_layers(lattice, face, first, last, descending, runs);
+        }
+        return true;
+}
+
+
+struct Lattice create_lattice(const char* vertexPath, const char* fragmentPath, int size, float voxel_scale, const struct LatticeMesh* mesh)
+{
+        struct Lattice result;
+
+        result.width = size;
+        result.height = size;
+        result.depth = size;
+        result.voxel_scale = voxel_scale;
+        result.shared_planes = mesh->shared_planes;
+        result.index_count = mesh->index_count;
+        result.index_type = mesh->index_bytes == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        glGenVertexArrays(1,&result.vao);
+        
+        // Create new individual Vertex and Element Buffer Objects
+        glGenBuffers(1, &result.vbo);
+        glGenBuffers(1, &result.ebo);
+
+        // Bind the requested VAO
+        glBindVertexArray(result.vao);
+        
+        // set the current VBO
+        glBindBuffer(GL_ARRAY_BUFFER, result.vbo);
+        // set the vertex data
+        glBufferData(GL_ARRAY_BUFFER, mesh->vertex_count*sizeof(struct LatticeVertex), mesh->vertices, GL_STATIC_DRAW);
+
+        // the element buffer binding is part of the VAO state
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, result.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->index_count*mesh->index_bytes, mesh->indices, GL_STATIC_DRAW);
+        
+        //  Configure the vertex data attributes
+        
+        //Layer and face/corner, read as integers
+        glVertexAttribIPointer(0,2,GL_UNSIGNED_SHORT,sizeof(struct LatticeVertex),(void*)0);
+        glEnableVertexAttribArray(0);
+        
+        // unbind/release the currently set buffers, the VAO first so it keeps its element buffer
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        
+        result.shader_program = load_shader(vertexPath, fragmentPath);
+        if (result.shader_program == -1)
+        {
+                printf("shader program didn't compile correctly\n");
+        }
+
+        return result;
+}
+
+
+struct Lattice create_procedural_lattice(const char* vertexPath, const char* fragmentPath, int size, float voxel_scale, bool shared_planes)
+{
+        struct Lattice result;
+
+        result.width = size;
+        result.height = size;
+        result.depth = size;
+        result.voxel_scale = voxel_scale;
+        result.shared_planes = shared_planes;
+        result.vbo = 0;
+        result.ebo = 0;
+        result.index_count = 0;
+        result.index_type = 0;
+
+        // core profiles can't draw without a vertex array even when it has no attributes
+        glGenVertexArrays(1,&result.vao);
+
+        result.shader_program = load_shader(vertexPath, fragmentPath);
+        if (result.shader_program == -1)
+        {
+                printf("shader program didn't compile correctly\n");
+        }
+
+        return result;
+}
+
+
+int create_lattice_mesh_data(int size, bool shared_planes, struct LatticeMesh* out)
+{
+        // two triangles over the 4 corners of a quad, the corner order is resolved in the vertex shader
+        const int quad_indices[6] = {0, 1, 2, 2, 3, 0};
+
+        // shared planes are the negative faces of each axis, one more than there are layers
+        int face_step = shared_planes ? 2 : 1;
+        int layers = shared_planes ? size+1 : size;
+
+        size_t face_count = (size_t)layers*(LATTICE_FACE_COUNT/face_step);
+        out->shared_planes = shared_planes;
+        out->vertex_count = face_count*4;
+        // every quad is indexed twice, once in ascending and once in descending layer order
+        out->index_count = face_count*6*2;
+        out->index_bytes = out->vertex_count <= 65536 ? 2 : 4;
+
+        printf("lattice chunk face count: %zu\n", face_count);
+        printf("number of bytes for the lattice mesh: %zu\n", out->vertex_count*sizeof(struct LatticeVertex)+out->index_count*out->index_bytes);
+
+        out->vertices = (struct LatticeVertex*) malloc(out->vertex_count*sizeof(struct LatticeVertex));
+        out->indices = malloc(out->index_count*out->index_bytes);
+        if (out->vertices == NULL || out->indices == NULL)
+        {
+                printf("Unable to create lattice data heap.\n");
+                free_lattice_mesh_data(out);
+                return -1;
+        }
+
+        size_t vertex = 0;
+        for (int face = 0 ; face < LATTICE_FACE_COUNT ; face += face_step)
+        {
+                for (int layer = 0 ; layer < layers ; layer++)
+                {
+                        for (int corner = 0 ; corner < 4 ; corner++)
+                        {
+                                (out->vertices+vertex)->layer = (uint16_t)layer;
+                                (out->vertices+vertex)->face_corner = (uint16_t)(face << 2 | corner);
+                                vertex++;
+                        }
+                }
+        }
+
+        for (size_t quad = 0 ; quad < face_count*2 ; quad++)
+        {
+                // quads past face_count repeat every face with its layers reversed
+                size_t group = quad%face_count/layers;
+                size_t layer = quad%layers;
+                if (quad >= face_count)
+                        layer = layers-1-layer;
+                uint32_t first_vertex = (group*layers+layer)*4;
+
+                for (int i = 0 ; i < 6 ; i++)
+                {
+                        uint32_t value = first_vertex+quad_indices[i];
+                        if (out->index_bytes == 2)
+                                *((uint16_t*)out->indices+quad*6+i) = (uint16_t)value;
+                        else
+                                *((uint32_t*)out->indices+quad*6+i) = value;
+                }
+        }
+
+        return 0;
+}
+
+
+void free_lattice_mesh_data(struct LatticeMesh* mesh)
+{
+        free(mesh->vertices);
+        free(mesh->indices);
+        mesh->vertices = NULL;
+        mesh->indices = NULL;
+}
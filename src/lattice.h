@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include "camera.h"
+
+// fraction of a switching distance the camera has to pass it by before the level changes
+#define LATTICE_LOD_HYSTERESIS 0.1f
+
+// faces of a lattice in the order their layers are laid out, in the mesh and for gl_VertexID
+enum LatticeFace
+{
+        LATTICE_FACE_NEGATIVE_Z,
+        LATTICE_FACE_POSITIVE_Z,
+        LATTICE_FACE_NEGATIVE_X,
+        LATTICE_FACE_POSITIVE_X,
+        LATTICE_FACE_NEGATIVE_Y,
+        LATTICE_FACE_POSITIVE_Y,
+        LATTICE_FACE_COUNT
+};
+
+
+// One corner of a layer quad, the vertex shader derives position and texture coordinate
+// from it with the LATTICE_SIZE and VOXEL_SCALE uniforms.
+typedef struct LatticeVertex
+{
+        uint16_t layer;
+        // face << 2 | corner
+        uint16_t face_corner;
+}LatticeVertex;
+
+
+// 4 vertices and 6 indices per layer quad, indices are 16 bit
+// while the vertices fit. The indices run over every face in ascending layer order and then
+// once more in descending order, so either direction is one contiguous range.
+// A shared plane mesh has size+1 double sided planes per axis instead of a quad for
+// each side of every layer, their face is always the negative face of the axis.
+typedef struct LatticeMesh
+{
+        bool shared_planes;
+        struct LatticeVertex* vertices;
+        size_t vertex_count;
+        void* indices;
+        size_t index_count;
+        int index_bytes;
+}LatticeMesh;
+
+
+typedef struct Lattice
+{
+        int width;
+        int height;
+        int depth;
+        unsigned int vbo;
+        unsigned int ebo;
+        unsigned int vao;
+        unsigned int shader_program;
+        // indices drawn and their GL type, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        int index_count;
+        unsigned int index_type;
+        float voxel_scale;
+        // one double sided plane between neighbouring layers, drawn without face culling,
+        // the fragment shader samples the layer on the far side using gl_FrontFacing
+        bool shared_planes;
+        // 3D texture sampled by the lattice faces, 0 leaves whatever is bound alone
+        unsigned int texture = 0;
+        // shader storage buffer of the texture's palette bound at binding 0, 0 for RGBA textures
+        unsigned int palette_buffer = 0;
+        // solid voxels in every texture layer along x, y and z, width entries per axis,
+        // layers without any are skipped, NULL draws every layer
+        const int* occupancy = NULL;
+        // GL_R8UI texture of EXPOSURE_* bits per voxel (exposure.h) bound to unit 1, faces of voxels
+        // not exposed in their direction are discarded before the colour is read, 0 draws every face
+        unsigned int exposure = 0;
+        // GL_RG32UI brick entries (brick_pool.h) bound to unit 2, texture is then the brick pool
+        // the entries point into, 0 samples texture directly
+        unsigned int indirection = 0;
+        // resident bindless handles of texture and exposure once a LatticeBatch has drawn the lattice
+        uint64_t texture_handle = 0;
+        uint64_t exposure_handle = 0;
+        // slot of the lattice in a GPU culled LatticeBatch, -1 if it has none
+        int batch_slot = -1;
+        // false when the lattice can't be seen from the camera through open air and isn't drawn
+        bool reachable = true;
+        // mip level of texture and exposure the layers sample, width matches that level
+        int texture_level = 0;
+        // coarser lattices draw_lattice draws instead from far away, lods[n-1] has width>>n layers
+        struct Lattice* lods = NULL;
+        int lod_count = 0;
+        // level drawn last, 0 for this lattice
+        int lod = 0;
+        // distance in lattice widths from which lods[0] is drawn, doubling for every further level
+        float lod_distance = 0.0f;
+        // texel of texture and exposure holding texel (0,0,0) of what the layers show, both wrap
+        // around past their far edge so a scrolling window only rotates where its texels start
+        glm::ivec3 texture_origin = glm::ivec3(0);
+        glm::mat4 model_matrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,0.0f,1.0f));
+}Lattice;
+
+
+// first quads and quad counts of runs of layer quads, in the order they are drawn
+typedef struct LatticeRuns
+{
+        std::vector<int> firsts;
+        std::vector<int> counts;
+        // index buffer offsets of the runs, filled when they are drawn from an index buffer
+        std::vector<const void*> offsets;
+}LatticeRuns;
+
+
+// Layers [first, last) of face whose front side faces position (in lattice model space),
+// every other layer of that face is back facing. Empty ranges have first == last.
+void lattice_visible_layers(const struct Lattice* lattice, glm::vec3 position, int face, int* first, int* last);
+// Model space bounds of the part of the lattice inside the frustum of clip, the
+// projection*view*model matrix. Returns false if no part of the lattice is inside.
+bool lattice_frustum_bounds(const struct Lattice* lattice, glm::mat4 clip, glm::vec3* low, glm::vec3* high);
+// Appends the runs of layers of lattice worth drawing from camera (whose projection is current),
+// returns false if no part of the lattice is in view. culling is whether GL_CULL_FACE is enabled.
+bool lattice_collect_runs(const struct Lattice* lattice, const struct Camera* camera, bool culling, struct LatticeRuns* runs);
+// smallest range [first, last) of layers of face group (a face, or an axis of shared planes)
+// holding every layer with solid voxels, empty if there are none
+void lattice_occupied_layers(const struct Lattice* lattice, int group, int* first, int* last);
+// world space bounding box of the lattice
+void lattice_bounds(const struct Lattice* lattice, glm::vec3* low, glm::vec3* high);
+// uniforms the vertex shader needs to rebuild the layer quads of lattices shaped like lattice
+void lattice_set_shape_uniforms(const struct Lattice* lattice, unsigned int shader_program);
+// Level of detail to draw lattice at from position, one of 0 to lod_count. A level is only left
+// once the distance is LATTICE_LOD_HYSTERESIS past the switching distance, so a camera
+// hovering around it doesn't make the lattice flicker between levels.
+int lattice_select_lod(const struct Lattice* lattice, glm::vec3 position);
+// Only layers that hold solid voxels and reach into the view frustum are submitted, with
+// GL_CULL_FACE enabled only the front facing ones of every face, in one multi draw call.
+// runs is scratch space for collecting them that the caller keeps between draws.
+void draw_lattice(GLFWwindow* window, struct Lattice* lattice, struct Camera* camera, struct LatticeRuns* runs);
+struct Lattice create_lattice(const char* vertexPath, const char* fragmentPath, int size, float voxel_scale, const struct LatticeMesh* mesh);
+// returns -1 if the mesh couldn't be allocated, free it with free_lattice_mesh_data once uploaded
+int create_lattice_mesh_data(int size, bool shared_planes, struct LatticeMesh* out);
+void free_lattice_mesh_data(struct LatticeMesh* mesh);
+// lattice without a vertex buffer, vbo is 0 and the vertex shader builds every layer quad from gl_VertexID
+struct Lattice create_procedural_lattice(const char* vertexPath, const char* fragmentPath, int size, float voxel_scale, bool shared_planes);
@@ -0,0 +1,457 @@
+#include "lattice_batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include "shader.h"
+
+// the loader has no ARB_bindless_texture entry points, they are fetched through GLFW
+#ifndef APIENTRYP
+#define APIENTRYP APIENTRY *
+#endif
+
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+
+// slots the GPU culling buffers start with, they double whenever they fill up
+#define LATTICE_BATCH_INITIAL_SLOTS 64
+// invocations per work group of latticeCull.glsl
+#define LATTICE_CULL_GROUP_SIZE 64
+
+typedef uint64_t (APIENTRYP LatticeGetTextureHandle)(GLuint texture);
+typedef void (APIENTRYP LatticeHandleResidency)(uint64_t handle);
+// GL 4.6 or ARB_indirect_parameters, the draw count is read from a buffer
+typedef void (APIENTRYP LatticeMultiDrawArraysIndirectCount)(GLenum mode, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+typedef void (APIENTRYP LatticeMultiDrawElementsIndirectCount)(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+
+static LatticeGetTextureHandle get_texture_handle = NULL;
+static LatticeHandleResidency make_handle_resident = NULL;
+static LatticeHandleResidency make_handle_non_resident = NULL;
+static LatticeMultiDrawArraysIndirectCount multi_draw_arrays_indirect_count = NULL;
+static LatticeMultiDrawElementsIndirectCount multi_draw_elements_indirect_count = NULL;
+
+
+struct LatticeBatch create_lattice_batch(const char* vertexPath, const char* fragmentPath, const struct Lattice* lattice)
+{
+        struct LatticeBatch result;
+
+        result.supported = false;
+        result.lattice = *lattice;
+        result.shader_program = 0;
+        result.draw_buffer = 0;
+        result.command_buffer = 0;
+        result.culling = true;
+        result.framebuffer_width = 0;
+        result.framebuffer_height = 0;
+        result.gpu_culling = false;
+        result.cull_program = 0;
+        result.cull_buffer = 0;
+        result.count_buffer = 0;
+        result.slot_capacity = 0;
+        result.slot_count = 0;
+        result.hiz.depth_texture = 0;
+        result.hiz.pyramid = 0;
+        result.hiz.reduce_program = 0;
+        result.hiz.reproject_program = 0;
+        result.hiz.reprojected = 0;
+        result.hiz.valid = false;
+
+        if (glfwExtensionSupported("GL_ARB_bindless_texture"))
+        {
+                get_texture_handle = (LatticeGetTextureHandle) glfwGetProcAddress("glGetTextureHandleARB");
+                make_handle_resident = (LatticeHandleResidency) glfwGetProcAddress("glMakeTextureHandleResidentARB");
+                make_handle_non_resident = (LatticeHandleResidency) glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+        }
+        if (get_texture_handle == NULL || make_handle_resident == NULL || make_handle_non_resident == NULL)
+        {
+                printf("bindless textures aren't supported, lattices are drawn one by one.\n");
+                return result;
+        }
+
+        result.shader_program = load_shader(vertexPath, fragmentPath);
+        glGenBuffers(1, &result.draw_buffer);
+        glGenBuffers(1, &result.command_buffer);
+        result.supported = true;
+
+        return result;
+}
+
+
+void free_lattice_batch(struct LatticeBatch* batch)
+{
+        if (batch->draw_buffer != 0)
+                glDeleteBuffers(1, &batch->draw_buffer);
+        if (batch->command_buffer != 0)
+                glDeleteBuffers(1, &batch->command_buffer);
+        if (batch->shader_program != 0)
+                glDeleteProgram(batch->shader_program);
+        if (batch->gpu_culling)
+        {
+                glDeleteBuffers(1, &batch->cull_buffer);
+                glDeleteBuffers(1, &batch->count_buffer);
+                glDeleteProgram(batch->cull_program);
+                free_hiz(&batch->hiz);
+        }
+        batch->draw_buffer = 0;
+        batch->command_buffer = 0;
+        batch->shader_program = 0;
+        batch->supported = false;
+        batch->gpu_culling = false;
+}
+
+
+// grows the slot buffers to capacity, keeping the entries of the slots handed out so far
+static void lattice_batch_reserve(struct LatticeBatch* batch, int capacity)
+{
+        unsigned int buffers[2] = {batch->draw_buffer, batch->cull_buffer};
+        size_t entry_sizes[2] = {sizeof(struct LatticeDraw), sizeof(struct LatticeCullEntry)};
+        for (int i = 0 ; i < 2 ; i++)
+        {
+                unsigned int grown;
+                glGenBuffers(1, &grown);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+                glBufferData(GL_COPY_WRITE_BUFFER, capacity*entry_sizes[i], NULL, GL_DYNAMIC_DRAW);
+                if (batch->slot_count > 0)
+                {
+                        glBindBuffer(GL_COPY_READ_BUFFER, buffers[i]);
+                        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, batch->slot_count*entry_sizes[i]);
+                }
+                glDeleteBuffers(1, &buffers[i]);
+                buffers[i] = grown;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        batch->draw_buffer = buffers[0];
+        batch->cull_buffer = buffers[1];
+
+        // the cull pass writes at most 6 commands per slot
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity*LATTICE_FACE_COUNT*sizeof(struct LatticeElementsCommand), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        batch->slot_capacity = capacity;
+}
+
+
+bool lattice_batch_enable_gpu_culling(struct LatticeBatch* batch, const char* cullPath, const char* reducePath, const char* reprojectPath)
+{
+        if (!batch->supported)
+                return false;
+
+        multi_draw_arrays_indirect_count = (LatticeMultiDrawArraysIndirectCount) glfwGetProcAddress("glMultiDrawArraysIndirectCount");
+        if (multi_draw_arrays_indirect_count == NULL)
+                multi_draw_arrays_indirect_count = (LatticeMultiDrawArraysIndirectCount) glfwGetProcAddress("glMultiDrawArraysIndirectCountARB");
+        multi_draw_elements_indirect_count = (LatticeMultiDrawElementsIndirectCount) glfwGetProcAddress("glMultiDrawElementsIndirectCount");
+        if (multi_draw_elements_indirect_count == NULL)
+                multi_draw_elements_indirect_count = (LatticeMultiDrawElementsIndirectCount) glfwGetProcAddress("glMultiDrawElementsIndirectCountARB");
+        if (multi_draw_arrays_indirect_count == NULL || multi_draw_elements_indirect_count == NULL)
+                printf("indirect draw counts aren't supported, culled lattices are drawn as empty commands.\n");
+
+        batch->cull_program = load_compute_shader(cullPath);
+        batch->hiz = create_hiz(reducePath, reprojectPath);
+        glGenBuffers(1, &batch->cull_buffer);
+        glGenBuffers(1, &batch->count_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->count_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        lattice_batch_reserve(batch, LATTICE_BATCH_INITIAL_SLOTS);
+        batch->gpu_culling = true;
+        return true;
+}
+
+
+// handles are made once per texture, the texture's contents can still be updated
+static void lattice_batch_make_resident(struct Lattice* lattice)
+{
+        if (lattice->texture_handle == 0 && lattice->texture != 0)
+        {
+                lattice->texture_handle = get_texture_handle(lattice->texture);
+                make_handle_resident(lattice->texture_handle);
+        }
+        if (lattice->exposure_handle == 0 && lattice->exposure != 0)
+        {
+                lattice->exposure_handle = get_texture_handle(lattice->exposure);
+                make_handle_resident(lattice->exposure_handle);
+        }
+}
+
+
+// uploads the draw and cull entries of the slot of lattice
+static void lattice_batch_write_slot(struct LatticeBatch* batch, struct Lattice* lattice)
+{
+        lattice_batch_make_resident(lattice);
+        struct LatticeDraw draw = {lattice->model_matrix, lattice->texture_handle, lattice->exposure_handle};
+
+        struct LatticeCullEntry entry;
+        glm::vec3 low, high;
+        lattice_bounds(lattice, &low, &high);
+        entry.low = glm::vec4(low, 1.0f);
+        entry.high = glm::vec4(high, lattice->reachable ? 1.0f : 0.0f);
+        int groups = lattice->shared_planes ? 3 : LATTICE_FACE_COUNT;
+        for (int group = 0 ; group < LATTICE_FACE_COUNT ; group++)
+        {
+                entry.layers[group][0] = 0;
+                entry.layers[group][1] = 0;
+                if (group < groups)
+                        lattice_occupied_layers(lattice, group, &entry.layers[group][0], &entry.layers[group][1]);
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->draw_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, lattice->batch_slot*sizeof(struct LatticeDraw), sizeof(struct LatticeDraw), &draw);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->cull_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, lattice->batch_slot*sizeof(struct LatticeCullEntry), sizeof(struct LatticeCullEntry), &entry);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+void lattice_batch_insert(struct LatticeBatch* batch, struct Lattice* lattice)
+{
+        if (!batch->gpu_culling || lattice->batch_slot != -1)
+                return;
+
+        if (batch->free_slots.empty())
+        {
+                if (batch->slot_count == batch->slot_capacity)
+                        lattice_batch_reserve(batch, batch->slot_capacity*2);
+                lattice->batch_slot = batch->slot_count++;
+        }
+        else
+        {
+                lattice->batch_slot = batch->free_slots.back();
+                batch->free_slots.pop_back();
+        }
+
+        lattice_batch_write_slot(batch, lattice);
+}
+
+
+void lattice_batch_update(struct LatticeBatch* batch, struct Lattice* lattice)
+{
+        if (!batch->gpu_culling || lattice->batch_slot == -1)
+                return;
+
+        lattice_batch_write_slot(batch, lattice);
+        // the captured depth may still hold voxels the edit removed, which could hide
+        // chunks behind them, so the next cull pass goes without the occlusion test
+        batch->hiz.valid = false;
+}
+
+
+void lattice_batch_set_reachable(struct LatticeBatch* batch, struct Lattice* lattice, bool reachable)
+{
+        if (lattice->reachable == reachable)
+                return;
+        lattice->reachable = reachable;
+        if (!batch->gpu_culling || lattice->batch_slot == -1)
+                return;
+
+        float flag = reachable ? 1.0f : 0.0f;
+        size_t offset = lattice->batch_slot*sizeof(struct LatticeCullEntry)+offsetof(struct LatticeCullEntry, high)+3*sizeof(float);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->cull_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, sizeof(float), &flag);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+void lattice_batch_remove(struct LatticeBatch* batch, struct Lattice* lattice)
+{
+        if (lattice->batch_slot != -1)
+        {
+                // a zero entry is skipped by the cull pass
+                struct LatticeCullEntry entry = {};
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->cull_buffer);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, lattice->batch_slot*sizeof(struct LatticeCullEntry), sizeof(struct LatticeCullEntry), &entry);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+                batch->free_slots.push_back(lattice->batch_slot);
+                lattice->batch_slot = -1;
+        }
+        lattice_batch_release(lattice);
+}
+
+
+void lattice_batch_begin(GLFWwindow* window, struct LatticeBatch* batch, struct Camera* camera)
+{
+        batch->draws.clear();
+        batch->arrays_commands.clear();
+        batch->elements_commands.clear();
+        batch->culling = glIsEnabled(GL_CULL_FACE);
+
+        glUseProgram(batch->shader_program);
+
+        set_shader_value_float("TIME", (float) glfwGetTime(), batch->shader_program);
+
+        int width,height;
+        glfwGetWindowSize(window, &width, &height);
+        set_shader_value_vec2("RESOLUTION", glm::vec2(width, height), batch->shader_program);
+        glfwGetFramebufferSize(window, &batch->framebuffer_width, &batch->framebuffer_height);
+
+        camera->projection = glm::perspective(glm::radians(camera->fov), (float)width/height, 0.001f, 3000.0f);
+}
+
+
+void lattice_batch_add(struct LatticeBatch* batch, struct Lattice* lattice, const struct Camera* camera)
+{
+        batch->runs.firsts.clear();
+        batch->runs.counts.clear();
+        if (!lattice_collect_runs(lattice, camera, batch->culling, &batch->runs) || batch->runs.firsts.empty())
+                return;
+
+        lattice_batch_make_resident(lattice);
+
+        unsigned int draw_index = batch->draws.size();
+        struct LatticeDraw draw = {lattice->model_matrix, lattice->texture_handle, lattice->exposure_handle};
+        batch->draws.push_back(draw);
+
+        // 6 vertices or indices per layer quad, gl_BaseInstance finds the draw entry
+        for (size_t i = 0 ; i < batch->runs.firsts.size() ; i++)
+        {
+                unsigned int first = batch->runs.firsts[i]*6;
+                unsigned int count = batch->runs.counts[i]*6;
+                if (lattice->vbo == 0)
+                {
+                        struct LatticeArraysCommand command = {count, 1, first, draw_index};
+                        batch->arrays_commands.push_back(command);
+                }
+                else
+                {
+                        struct LatticeElementsCommand command = {count, 1, first, 0, draw_index};
+                        batch->elements_commands.push_back(command);
+                }
+        }
+}
+
+
+// runs the cull pass over every slot and draws the commands it wrote,
+// then keeps this frame's depth for the next frame's occlusion test.
+// The depth of the previous frame is reprojected into this one before the test, so a camera
+// that moved doesn't compare boxes against depth that no longer covers them.
+static void lattice_batch_end_gpu(struct LatticeBatch* batch, const struct Camera* camera)
+{
+        if (batch->slot_count == 0)
+                return;
+
+        bool procedural = batch->lattice.vbo == 0;
+        bool compact = procedural ? multi_draw_arrays_indirect_count != NULL : multi_draw_elements_indirect_count != NULL;
+        glm::mat4 view_projection = camera->projection*camera->view;
+
+        unsigned int zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->count_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        hiz_build(&batch->hiz, view_projection);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batch->draw_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, batch->cull_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, batch->command_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, batch->count_buffer);
+
+        glUseProgram(batch->cull_program);
+        set_shader_value_int("SLOT_COUNT", batch->slot_count, batch->cull_program);
+        set_shader_value_matrix4("VIEW_PROJECTION", view_projection, batch->cull_program);
+        set_shader_value_vec3("CAMERA_POSITION", camera->position, batch->cull_program);
+        set_shader_value_int("CULLING", batch->culling, batch->cull_program);
+        set_shader_value_int("COMPACT", compact, batch->cull_program);
+        lattice_set_shape_uniforms(&batch->lattice, batch->cull_program);
+        set_shader_value_int("HIZ", batch->hiz.valid, batch->cull_program);
+        if (batch->hiz.valid)
+        {
+                glBindTexture(GL_TEXTURE_2D, batch->hiz.pyramid);
+                set_shader_value_int("PYRAMID", 0, batch->cull_program);
+                set_shader_value_int("PYRAMID_LEVELS", batch->hiz.levels, batch->cull_program);
+                set_shader_value_matrix4("PYRAMID_VIEW_PROJECTION", batch->hiz.pyramid_view_projection, batch->cull_program);
+        }
+        glDispatchCompute((batch->slot_count+LATTICE_CULL_GROUP_SIZE-1)/LATTICE_CULL_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindVertexArray(batch->lattice.vao);
+        glUseProgram(batch->shader_program);
+        set_shader_value_matrix4("view", camera->view, batch->shader_program);
+        set_shader_value_matrix4("projection", camera->projection, batch->shader_program);
+        lattice_set_shape_uniforms(&batch->lattice, batch->shader_program);
+        set_shader_value_int("BATCHED", 1, batch->shader_program);
+
+        // without draw counts every slot's 6 commands are drawn, the culled ones are empty
+        int max_commands = batch->slot_count*LATTICE_FACE_COUNT;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->command_buffer);
+        glBindBuffer(GL_PARAMETER_BUFFER, batch->count_buffer);
+        if (batch->lattice.shared_planes && batch->culling)
+                glDisable(GL_CULL_FACE);
+        if (procedural && compact)
+                multi_draw_arrays_indirect_count(GL_TRIANGLES, 0, 0, max_commands, 0);
+        else if (procedural)
+                glMultiDrawArraysIndirect(GL_TRIANGLES, 0, max_commands, 0);
+        else if (compact)
+                multi_draw_elements_indirect_count(GL_TRIANGLES, batch->lattice.index_type, 0, 0, max_commands, 0);
+        else
+                glMultiDrawElementsIndirect(GL_TRIANGLES, batch->lattice.index_type, 0, max_commands, 0);
+        if (batch->lattice.shared_planes && batch->culling)
+                glEnable(GL_CULL_FACE);
+        glBindBuffer(GL_PARAMETER_BUFFER, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        hiz_capture(&batch->hiz, batch->framebuffer_width, batch->framebuffer_height, view_projection);
+}
+
+
+void lattice_batch_end(struct LatticeBatch* batch, const struct Camera* camera)
+{
+        if (batch->gpu_culling)
+        {
+                lattice_batch_end_gpu(batch, camera);
+                return;
+        }
+
+        bool procedural = batch->lattice.vbo == 0;
+        size_t command_count = procedural ? batch->arrays_commands.size() : batch->elements_commands.size();
+        if (command_count == 0)
+                return;
+
+        glBindVertexArray(batch->lattice.vao);
+        glUseProgram(batch->shader_program);
+
+        set_shader_value_matrix4("view", camera->view, batch->shader_program);
+        set_shader_value_matrix4("projection", camera->projection, batch->shader_program);
+        lattice_set_shape_uniforms(&batch->lattice, batch->shader_program);
+        set_shader_value_int("BATCHED", 1, batch->shader_program);
+
+        // both buffers are respecified every frame so the driver can orphan last frame's storage
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->draw_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, batch->draws.size()*sizeof(struct LatticeDraw), batch->draws.data(), GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batch->draw_buffer);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->command_buffer);
+        if (procedural)
+                glBufferData(GL_DRAW_INDIRECT_BUFFER, command_count*sizeof(struct LatticeArraysCommand), batch->arrays_commands.data(), GL_STREAM_DRAW);
+        else
+                glBufferData(GL_DRAW_INDIRECT_BUFFER, command_count*sizeof(struct LatticeElementsCommand), batch->elements_commands.data(), GL_STREAM_DRAW);
+
+        if (batch->lattice.shared_planes && batch->culling)
+                glDisable(GL_CULL_FACE);
+        if (procedural)
+                glMultiDrawArraysIndirect(GL_TRIANGLES, 0, command_count, 0);
+        else
+                glMultiDrawElementsIndirect(GL_TRIANGLES, batch->lattice.index_type, 0, command_count, 0);
+        if (batch->lattice.shared_planes && batch->culling)
+                glEnable(GL_CULL_FACE);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+
+void lattice_batch_release(struct Lattice* lattice)
+{
+        if (make_handle_non_resident == NULL)
+                return;
+        if (lattice->texture_handle != 0)
+                make_handle_non_resident(lattice->texture_handle);
+        if (lattice->exposure_handle != 0)
+                make_handle_non_resident(lattice->exposure_handle);
+        lattice->texture_handle = 0;
+        lattice->exposure_handle = 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <GLFW/glfw3.h>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include <vector>
+
+#include "camera.h"
+#include "hiz.h"
+#include "lattice.h"
+
+
+// Per draw entry of the shader storage buffer at binding 1, indexed by gl_BaseInstance.
+// Matches the std430 layout of LatticeDraw in genericVertex.glsl and batchedFragment.glsl.
+typedef struct LatticeDraw
+{
+        glm::mat4 model;
+        // bindless handles of the lattice's 3D texture and exposure mask, 0 for no mask
+        uint64_t texture_handle;
+        uint64_t exposure_handle;
+}LatticeDraw;
+
+
+// Per slot entry of the GPU culling pass at binding 2, matching latticeCull.glsl.
+typedef struct LatticeCullEntry
+{
+        // world space bounds, low.w is 1 for a slot holding a lattice and 0 for a free one,
+        // high.w is 0 while the lattice isn't reachable
+        glm::vec4 low;
+        glm::vec4 high;
+        // occupied layers [first, last) of every face, or of the 3 shared plane axes
+        int layers[LATTICE_FACE_COUNT][2];
+}LatticeCullEntry;
+
+
+// the command layouts glMultiDrawArraysIndirect and glMultiDrawElementsIndirect read
+typedef struct LatticeArraysCommand
+{
+        unsigned int count;
+        unsigned int instance_count;
+        unsigned int first;
+        unsigned int base_instance;
+}LatticeArraysCommand;
+
+typedef struct LatticeElementsCommand
+{
+        unsigned int count;
+        unsigned int instance_count;
+        unsigned int first_index;
+        int base_vertex;
+        unsigned int base_instance;
+}LatticeElementsCommand;
+
+
+// Draws many lattices sharing the mesh (or procedural layout) of one lattice with a single
+// indirect multi draw. Every lattice added gets a LatticeDraw entry with its model matrix
+// and texture handles, and one command per run of layers it collects, so the CPU culling
+// of draw_lattice still applies but no GL call is made per lattice.
+// Textures are read through ARB_bindless_texture handles, without it supported is false
+// and callers should draw every lattice with draw_lattice instead.
+typedef struct LatticeBatch
+{
+        bool supported;
+        // copy of the lattice whose vao, mesh and shape every batched lattice shares
+        struct Lattice lattice;
+        unsigned int shader_program;
+        // shader storage buffer of the LatticeDraw entries and the indirect command buffer
+        unsigned int draw_buffer;
+        unsigned int command_buffer;
+        std::vector<struct LatticeDraw> draws;
+        std::vector<struct LatticeArraysCommand> arrays_commands;
+        std::vector<struct LatticeElementsCommand> elements_commands;
+        struct LatticeRuns runs;
+        // GL_CULL_FACE state when the batch began
+        bool culling;
+        // framebuffer size when the batch began
+        int framebuffer_width;
+        int framebuffer_height;
+
+        // GPU driven mode, see lattice_batch_enable_gpu_culling. Lattices keep a slot of
+        // the draw buffer and cull buffer from lattice_batch_insert until lattice_batch_remove.
+        bool gpu_culling;
+        unsigned int cull_program;
+        // LatticeCullEntry of every slot and the number of commands the cull pass wrote
+        unsigned int cull_buffer;
+        unsigned int count_buffer;
+        int slot_capacity;
+        // slots ever handed out, the cull pass runs over all of them
+        int slot_count;
+        std::vector<int> free_slots;
+        // depth of the previous frame the cull pass tests slots against
+        struct HiZ hiz;
+}LatticeBatch;
+
+
+// fragmentPath has to read its textures from the draw buffer, see batchedFragment.glsl
+struct LatticeBatch create_lattice_batch(const char* vertexPath, const char* fragmentPath, const struct Lattice* lattice);
+void free_lattice_batch(struct LatticeBatch* batch);
+
+// starts a frame of the batch, updating the camera projection like draw_lattice does
+void lattice_batch_begin(GLFWwindow* window, struct LatticeBatch* batch, struct Camera* camera);
+// queues the visible layers of lattice, which has to share the batch lattice's vao,
+// making its texture handles resident the first time it is added
+void lattice_batch_add(struct LatticeBatch* batch, struct Lattice* lattice, const struct Camera* camera);
+// uploads the queued draws and commands and submits them with one indirect multi draw
+void lattice_batch_end(struct LatticeBatch* batch, const struct Camera* camera);
+// Switches the batch to culling on the GPU, call before inserting any lattice. Every frame
+// a compute pass tests each slot against the frustum and the previous frame's depth,
+// reprojected into the current view, and writes the indirect commands the draw consumes, lattice_batch_add is then unused.
+// Returns false if the batch isn't supported.
+bool lattice_batch_enable_gpu_culling(struct LatticeBatch* batch, const char* cullPath, const char* reducePath, const char* reprojectPath);
+// gives lattice a slot and uploads its draw and cull entries, nothing without GPU culling
+void lattice_batch_insert(struct LatticeBatch* batch, struct Lattice* lattice);
+// uploads the entries of lattice again after its voxels or textures changed,
+// the next cull pass skips the occlusion test as the captured depth may be stale
+void lattice_batch_update(struct LatticeBatch* batch, struct Lattice* lattice);
+// sets lattice->reachable, uploading it to the slot of a GPU culled lattice when it changes
+void lattice_batch_set_reachable(struct LatticeBatch* batch, struct Lattice* lattice, bool reachable);
+// frees the slot of lattice and releases its texture handles
+void lattice_batch_remove(struct LatticeBatch* batch, struct Lattice* lattice);
+// makes the texture handles of lattice non resident, call before deleting or recreating its textures
+void lattice_batch_release(struct Lattice* lattice);
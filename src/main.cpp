@@ -13,190 +13,14 @@
 #include <fstream>
 #include <filesystem>
 
-// 20 bytes per voxel
-// this only meant to be stored in a block palette
-// or a something like that, we need to avoid instancing it for every single instance
-typedef struct Voxel
-{
-        float r;
-        float g;
-        float b;
-        float a;
-        int temperature;
-}Voxel;
-
-
-typedef struct Lattice
-{
-        int width;
-        int height;
-        int depth;
-        unsigned int vbo;
-        unsigned int vao;
-        unsigned int shader_program;
-        int vbo_size;
-        glm::mat4 model_matrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,0.0f,1.0f));
-}Lattice;
-
-
-typedef struct Camera
-{
-        const float fov = 70.0f;
-        float speed = 0.25f;
-        const float sensitivity = 0.05f;
-        float yaw=90.f,pitch;
-        glm::vec3 position = glm::vec3(0.0f,0.0f,-1.0f);
-        //glm::vec3 target = glm::vec3(0.0f,0.0f,0.0f);
-        glm::vec3 direction;// = glm::normalize(position - target);
-        glm::vec3 front;
-        glm::vec3 up;
-        glm::vec3 right;
-        glm::mat4 view = glm::mat4(1.0f);
-        glm::mat4 projection;
-}Camera;
-
-
-// free out!
-int read_file(const char * path, char** out)
-{
-        std::ifstream file (path);
-        if (file.is_open())
-        {
-                long long file_size = std::filesystem::file_size(path);
-                
-                *out = (char*) malloc((file_size+1)*sizeof(char));
-                for (long long i = 0 ; i < file_size; i++)
-                {
-                        char c;
-                        file.get(c);
-                        *(*out+i) = c;
-                }
-                // terminating byte because final character isn't one?
-                *(*out+file_size) = '\0';
-                file.close();
-        }
-        else
-        {
-                printf("Unable to read file at: %s\n",path);
-                file.close();
-                return -1;
-        }
-        return 0;
-}
-
-
-void set_shader_value_float(const char * loc, float value, unsigned int shader_program)
-{
-        int location = glGetUniformLocation(shader_program, loc);
-        if (location == -1)
-                return;//printf("Unable to locate uniform %s in shader %d\n",loc,shader_program);
-        else
-                glUniform1f(location, value);
-}
-
-
-void set_shader_value_vec2(const char * loc, glm::vec2 value, unsigned int shader_program)
-{
-        int location = glGetUniformLocation(shader_program, loc);
-        if (location == -1)
-                return;//printf("Unable to locate uniform %s in shader %d\n",loc,shader_program);
-        else
-                glUniform2f(location, value.x, value.y);
-}
-
-
-void set_shader_value_float_array(const char * loc, float* value, int size, unsigned int shader_program)
-{
-        int location = glGetUniformLocation(shader_program, loc);
-        if (location == -1)
-                return;//printf("Unable to locate uniform %s in shader %d\n",loc,shader_program);
-        else
-                glUniform1fv(location,size,value);
-}
-
-
-void set_shader_value_matrix4(const char * loc, glm::mat4 value, unsigned int shader_program)
-{
-        int location = glGetUniformLocation(shader_program, loc);
-        if (location == -1)
-                return;//printf("Unable to locate uniform %s in shader %d\n",loc,shader_program);
-        else
-                glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
-}
+#include "camera.h"
+#include "chunk.h"
+#include "lattice.h"
+#include "lattice_batch.h"
+#include "shader.h"
+#include "world.h"
 
 
-unsigned int load_shader(const char* vertex_shaderPath, const char* fragment_shaderPath)
-{
-        // VERTEX
-        char * vertex_source;
-        int vertex_file = read_file(vertex_shaderPath, &vertex_source);
-        if (vertex_file != 0)
-        {
-                printf("unable to compile shader. vertex shader couldn't be found.\n");
-                return -1;
-        }
-	
-	    unsigned int vertex_shader;
-	    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	    glShaderSource(vertex_shader, 1, (const char* const *)&vertex_source, NULL);
-	    glCompileShader(vertex_shader);
-
-	    int vertex_success;
-	    char vertex_info_log[512];
-	    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &vertex_success);
-	    if(!vertex_success)
-	    {
-	    	glGetShaderInfoLog(vertex_shader, 512, NULL, vertex_info_log);
-	    	printf("ERROR::SHADER::VERTEX::COMPILATION_FAILED: %s\n",vertex_info_log);
-	    }
-	    free(vertex_source);
-
-        // FRAGMENT
-
-        char * fragment_source;
-        int fragment_file = read_file(fragment_shaderPath, &fragment_source);
-        if (fragment_file != 0)
-        {
-                printf("unable to compile shader. fragment shader couldn't be found.\n");
-                return -1;
-        }
-
-	    unsigned int fragment_shader;
-	    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	    glShaderSource(fragment_shader, 1, (const char* const *)&fragment_source, NULL);
-	    glCompileShader(fragment_shader);
-	    
-	    int fragment_success;
-	    char fragment_info_log[512];
-	    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &fragment_success);
-	    if(!fragment_success)
-	    {
-	    	glGetShaderInfoLog(fragment_shader, 512, NULL, fragment_info_log);
-	    	printf("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED: %s\n",fragment_info_log);
-	    }
-	    free(fragment_source);
-
-	    //SHADER PROGRAM
-	    unsigned int shader = glCreateProgram();
-	    glAttachShader(shader, vertex_shader);
-	    glAttachShader(shader, fragment_shader);
-	    glLinkProgram(shader);
-
-	    int shader_success;
-	    char shader_info_log[512];
-	    glGetProgramiv(shader, GL_LINK_STATUS, &shader_success);
-	    if(!shader_success)
-	    {
-	    	glGetProgramInfoLog(shader, 512, NULL, shader_info_log);
-	    	printf("ERROR::SHADER::PROGRAM::COMPILATION_FAILED: %s\n",shader_info_log);
-	    }
-	    
-	    glDeleteShader(vertex_shader);
-	    glDeleteShader(fragment_shader);
-
-	    return shader;
-}
-
 /*
 // creates the textures to be displayed on chunk lattices
 void texture_packer(int** chunk_data, int chunk_data_size, int chunk_width, int chunk_height, int chunk_depth, unsigned int* out_texture_id)
@@ -326,495 +150,106 @@ void input_process(GLFWwindow* window, struct Camera* camera, float frame_delta)
 }
 
 
-void draw_lattice(GLFWwindow* window, struct Lattice* lattice, struct Camera* camera)
+void print_mat4(glm::mat4 mat)
 {
-        glBindVertexArray(lattice->vao);
-
-        // TODO set the texture buffer once the texture packer is done
-        glUseProgram(lattice->shader_program);
-
-        set_shader_value_float("TIME", (float) glfwGetTime(), lattice->shader_program);
-
-        int width,height;
-        glfwGetWindowSize(window, &width, &height);
-        glm::vec2 resolution = glm::vec2(width, height);
-        set_shader_value_vec2("RESOLUTION", resolution, lattice->shader_program);
-        
-        camera->projection = glm::perspective(glm::radians(camera->fov), (float)width/height, 0.001f, 3000.0f);
-
-        set_shader_value_matrix4("model", lattice->model_matrix, lattice->shader_program);
-        set_shader_value_matrix4("view", camera->view, lattice->shader_program);
-        set_shader_value_matrix4("projection", camera->projection, lattice->shader_program);
-
-        glDrawArrays(GL_TRIANGLES, 0, lattice->vbo_size);
+        printf("%f %f %f %f\n%f %f %f %f\n%f %f %f %f\n%f %f %f %f\n",mat[0][0], mat[0][1],mat[0][2],mat[0][3],mat[1][0],mat[1][1],mat[1][2],mat[1][3],mat[2][0],mat[2][1],mat[2][2],mat[2][3],mat[3][0],mat[3][1],mat[3][2],mat[3][3]);
 }
 
 
-struct Lattice create_lattice(const char* vertexPath, const char* fragmentPath, float* vbo_data, size_t vbo_size)
+void lattice_compensation()
 {
-        struct Lattice result;
-
-        glGenVertexArrays(1,&result.vao);
-        result.vbo_size = vbo_size;
-        
-        // Create new individual Vertex Buffer Object  
-        glGenBuffers(1, &result.vbo);
-
-        // Bind the requested VAO
-        glBindVertexArray(result.vao);
-        
-        // set the current VBO
-        glBindBuffer(GL_ARRAY_BUFFER, result.vbo);
-        // set the vertex data
-        glBufferData(GL_ARRAY_BUFFER, vbo_size, vbo_data, GL_STATIC_DRAW);
-        
-        //  Configure the vertex data attributes
-        
-        //Vertex Postion
-        glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,6*sizeof(float),(void*)0);
-        glEnableVertexAttribArray(0);
-               
-        //UV Postion
-        glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,6*sizeof(float),(void*)(3*sizeof(float)));
-        glEnableVertexAttribArray(1);
-        
-        // unbind/release the currently set buffers 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-        
-        result.shader_program = load_shader(vertexPath, fragmentPath);
-        if (result.shader_program == -1)
-        {
-                printf("shader program didn't compile correctly\n");
-        }
-
-        return result;
+        ;
 }
 
 
-void create_lattice_mesh_data(int size, float voxel_scale, float** out, size_t* out_size)
+// lattice of size layers drawn with the generic vertex shader, returns -1 if its mesh couldn't be allocated
+int create_demo_lattice(const char* fragment_path, int size, float voxel_scale, bool procedural, bool shared_planes, struct Lattice* out)
 {
-        //number of floats per vertex
-        const int vertex_stride = 6;
-        //number of vertices per index / number of vertices required for a face
-        const int index_stride = 6;
-        
-        long long int vertex_offset = 0;
-
-        printf("size: %d\n",size);
-        // 6 floats per vertex, width*2 + height*2 + depth*2 = face count, face_count * 6 * 6 * sizeof(float) = byte count
-        size_t face_count = size*6;
-        // face count * 6 vertices * 6 floats per vertex (3 floats for position, 3 for UV) * sizeof float (should be 4 bytes/32bits)
-        size_t float_count = face_count * index_stride * vertex_stride;
-        size_t byte_count = float_count*sizeof(float);
-        printf("size of float: %zu\n",sizeof(float));
-        printf("lattice chunk face count: %zu\n", face_count);
-        printf("float count: %zu\n",float_count);
-        printf("number of bytes for the lattice mesh: %zu\n", float_count*sizeof(float));
-        
-        *out = (float *) calloc(1, byte_count);
-        *out_size = byte_count;
-
-        if (*out == NULL)
-        {
-                printf("Unable to create lattice data heap.\n");
-        }
-        
-        // Negative Z faces
-        for (int z = 0 ; z < size ; z++)
-        {
-                float layer = ((float)z)/(size-1);
-                if (z == size-1)
-                        layer-=0.000001;
-                // BOTTOM FACE
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -z*voxel_scale;
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -z*voxel_scale;
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -z*voxel_scale;
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                // TOP FACE
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -z*voxel_scale;
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -z*voxel_scale;
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -z*voxel_scale;
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-        }
-
-        // POSITIVE Z FACES
-        for (int z = 0 ; z < size ; z++)
-        {
-                float layer = ((float)z)/(size-1);
-                if (z == size-1)
-                        layer-=0.000001;
-                // BOTTOM FACE
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -z*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -z*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -z*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                // TOP FACE
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -z*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -z*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = layer;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -z*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = layer;
-        
-                vertex_offset+=vertex_stride;
-        }
-
-        // NEGATIVE X FACES
-        for (int x = 0 ; x < size ; x++)
-        {
-                float layer = 1.0f-((float)x)/(size-1);
-                if (x == 0)
-                        layer -= 0.000001;
-                // BOTTOM FACE
-                *(*out+vertex_offset+0) = x*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                // TOP FACE
-                *(*out+vertex_offset+0) = x*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = 0.0f;
-        
-                vertex_offset+=vertex_stride;
-        }
-
-        // POSITIVE X FACES
-        for (int x = 0 ; x < size ; x++)
-        {
-                float layer = 1.0f-((float)x)/(size-1);
-                if (x == 0)
-                        layer -= 0.000001;
-                // BOTTOM FACE
-                *(*out+vertex_offset+0) = x*voxel_scale;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                // TOP FACE
-                *(*out+vertex_offset+0) = x*voxel_scale;
-                *(*out+vertex_offset+1) = 0.0f;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 0.0f;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = x*voxel_scale;
-                *(*out+vertex_offset+1) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = layer;
-                *(*out+vertex_offset+4) = 1.0f;
-                *(*out+vertex_offset+5) = 1.0f;
-        
-                vertex_offset+=vertex_stride;
-        }
-
-        // NEGATIVE Y FACES
-        for (int y = 0 ; y < size ; y++)
+        if (procedural)
         {
-                float layer = ((float)y)/(size-1);
-                if (y == size-1)
-                        layer-=0.000001;
-                // BOTTOM FACE
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = y*voxel_scale;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = y*voxel_scale;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = y*voxel_scale;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                // TOP FACE
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = y*voxel_scale;
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = y*voxel_scale;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = y*voxel_scale;
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 1.0f;
-                
-                vertex_offset+=vertex_stride;
+                *out = create_procedural_lattice("resources/genericVertex.glsl", fragment_path, size, voxel_scale, shared_planes);
+                return 0;
         }
 
-        // POSITIVE Y FACES
-        for (int y = 0 ; y < size ; y++)
-        {
-                float layer = ((float)y)/(size-1);
-                if (y == size-1)
-                        layer-=0.000001;
-                // BOTTOM FACE
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = y*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = y*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 0.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = y*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                // TOP FACE
-                *(*out+vertex_offset+0) = 1.0f*voxel_scale*size;
-                *(*out+vertex_offset+1) = y*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 0.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 1.0f;
-
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = y*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+2) = -1.0f*voxel_scale*size+(1.0f*voxel_scale);
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 1.0f;
-                
-                vertex_offset+=vertex_stride;
-
-                *(*out+vertex_offset+0) = 0.0f;
-                *(*out+vertex_offset+1) = y*voxel_scale+(1.0f*voxel_scale);
-                *(*out+vertex_offset+2) = 1.0f*voxel_scale;
-                *(*out+vertex_offset+3) = 1.0f;
-                *(*out+vertex_offset+4) = layer;
-                *(*out+vertex_offset+5) = 0.0f;
-                
-                vertex_offset+=vertex_stride;
-        }
+        struct LatticeMesh lattice_mesh;
+        if (create_lattice_mesh_data(size, shared_planes, &lattice_mesh) != 0)
+                return -1;
+        *out = create_lattice("resources/genericVertex.glsl", fragment_path, size, voxel_scale, &lattice_mesh);
+        free_lattice_mesh_data(&lattice_mesh);
+        return 0;
 }
 
 
-void print_mat4(glm::mat4 mat)
+// random noise of the demo block types
+void generate_random_chunk(struct Chunk* chunk, glm::ivec3 position)
 {
-        printf("%f %f %f %f\n%f %f %f %f\n%f %f %f %f\n%f %f %f %f\n",mat[0][0], mat[0][1],mat[0][2],mat[0][3],mat[1][0],mat[1][1],mat[1][2],mat[1][3],mat[2][0],mat[2][1],mat[2][2],mat[2][3],mat[3][0],mat[3][1],mat[3][2],mat[3][3]);
-}
+        struct Voxel purple = {0xDF/255.0f, 0.0f, 1.0f, 1.0f, 0};
+        struct Voxel magenta = {1.0f, 0.0f, 1.0f, 1.0f, 0};
 
+        int block_types[3] = {0, chunk_palette_index(chunk, purple), chunk_palette_index(chunk, magenta)};
 
-void lattice_compensation()
-{
-        ;
+        for (int z = 0 ; z < chunk->size ; z++)
+        {
+                for (int y = 0 ; y < chunk->size ; y++)
+                {
+                        for (int x = 0 ; x < chunk->size ; x++)
+                                chunk_set_index(chunk, x, y, z, block_types[rand()%3]);
+                }
+        }
 }
 
 
 int main(int argc, char* argv[])
 {
+        // any argument other than a known flag turns on wireframe rendering
+        bool wireframe = false;
+        enum ChunkBackend chunk_backend = CHUNK_BACKEND_PALETTE;
+        // region files of the world, --no-save keeps every chunk in memory only
+        const char* save_directory = "save";
+        // --indexed keeps palette indices in the chunk textures and resolves colours in the fragment shader
+        enum WorldTextureFormat texture_format = WORLD_TEXTURE_RGBA;
+        // --procedural builds the lattice faces in the vertex shader instead of uploading a mesh
+        bool procedural = false;
+        // --shared-planes draws one double sided plane between neighbouring layers
+        bool shared_planes = false;
+        // --batched draws every chunk with one indirect multi draw through bindless textures
+        bool batched = false;
+        // --gpu-culling batches the chunks and lets a compute pass cull them and write the draws
+        bool gpu_culling = false;
+        // --lod draws distant chunks from downsampled voxels with coarser lattices
+        bool lods = false;
+        // --clipmap draws the chunks around the camera as one global lattice over a scrolling texture
+        bool clipmap_mode = false;
+        // --bricked keeps the colours of every chunk in one pool of bricks, uniform bricks take no space
+        bool bricked = false;
+        for (int i = 1 ; i < argc ; i++)
+        {
+                if (strcmp(argv[i], "--octree") == 0)
+                        chunk_backend = CHUNK_BACKEND_OCTREE;
+                else if (strcmp(argv[i], "--rle") == 0)
+                        chunk_backend = CHUNK_BACKEND_RLE;
+                else if (strcmp(argv[i], "--no-save") == 0)
+                        save_directory = NULL;
+                else if (strcmp(argv[i], "--indexed") == 0)
+                        texture_format = WORLD_TEXTURE_INDEXED;
+                else if (strcmp(argv[i], "--procedural") == 0)
+                        procedural = true;
+                else if (strcmp(argv[i], "--shared-planes") == 0)
+                        shared_planes = true;
+                else if (strcmp(argv[i], "--batched") == 0)
+                        batched = true;
+                else if (strcmp(argv[i], "--gpu-culling") == 0)
+                        batched = gpu_culling = true;
+                else if (strcmp(argv[i], "--lod") == 0)
+                        lods = true;
+                else if (strcmp(argv[i], "--clipmap") == 0)
+                        clipmap_mode = true;
+                else if (strcmp(argv[i], "--bricked") == 0)
+                        bricked = true;
+                else
+                        wireframe = true;
+        }
+
         // Set minimum version of opengl
         // We are using at minimum version 4.4 which supports texture arrays
         
@@ -847,127 +282,124 @@ int main(int argc, char* argv[])
 
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-        int lattice_size = 256;
-        float * lattice_data;
-        size_t lattice_data_size;
-        create_lattice_mesh_data(lattice_size, 0.1f, &lattice_data, &lattice_data_size);
-
-        printf("lattice data size: %zu\n",lattice_data_size);
-
-        struct Lattice chicken = create_lattice("resources/genericVertex.glsl", "resources/genericFragment.glsl", lattice_data, lattice_data_size);
-
+        int lattice_size = 64;
+        // number of chunks kept resident around the camera in every direction
+        int view_distance = 1;
+        const char* fragment_path = texture_format == WORLD_TEXTURE_INDEXED ? "resources/indexedFragment.glsl" : "resources/genericFragment.glsl";
+        struct Lattice chicken;
+        if (create_demo_lattice(fragment_path, lattice_size, 0.1f, procedural, shared_planes, &chicken) != 0)
+                return -1;
         printf("passed the lattice data\n");
 
-        free(lattice_data);
-
         int chunk_data_size = lattice_size*lattice_size*lattice_size;
         printf("chunk data size: %d\n",chunk_data_size);
-        int* chunk_data = (int*) malloc(chunk_data_size*sizeof(int));
-        printf("size of chunk_data: %zu\n",chunk_data_size*sizeof(int));
 
-        for (int i = 0 ; i < chunk_data_size ; i++)
+        struct World world = create_world(chicken, lattice_size, 0.1f, chunk_backend, texture_format, generate_random_chunk, save_directory);
+
+        // coarser lattices of the chunks further than lod_distance chunk widths away
+        for (int level = 1 ; lods && level <= WORLD_MAX_LODS && (lattice_size >> (level-1))%2 == 0 ; level++)
         {
-                *(chunk_data+i) = rand()%3;
+                struct Lattice lod;
+                if (create_demo_lattice(fragment_path, lattice_size >> level, 0.1f*(1 << level), procedural, shared_planes, &lod) != 0)
+                        break;
+                world.lod_lattices.push_back(lod);
         }
 
-        float start_time = glfwGetTime();
-
-        unsigned int lattice_chunk_albedo;
-        
-        glGenTextures(1, &lattice_chunk_albedo);
-        glBindTexture(GL_TEXTURE_3D, lattice_chunk_albedo);
-
-        unsigned char* stone = (unsigned char * ) malloc(4*sizeof(char));
-
-        *(stone) = 0x00;
-        *(stone+1) = 0x00;
-        *(stone+2) = 0xFF;
-        *(stone+3) = 0xFF;
-
-        unsigned char* origin = (unsigned char*) malloc(4*sizeof(char));
-
-        *(origin) = 0xFF;
-        *(origin+1) = 0x00;
-        *(origin+2) = 0x00;
-        *(origin+3) = 0xFF;
-        
-        unsigned char* zp = (unsigned char* ) malloc(4*sizeof(char));
-        *(zp) = 0x00;
-        *(zp+1) = 0xFF;
-        *(zp+2) = 0x00;
-        *(zp+3) = 0xFF;
-
-        unsigned char * xp = (unsigned char *) malloc(4*sizeof(char));
-        *(xp) = 0x70;
-        *(xp+1) = 0xFF;
-        *(xp+2) = 0x00;
-        *(xp+3) = 0xFF;
+        // the batched fragment shader samples RGBA textures, indexed worlds draw chunk by chunk
+        struct LatticeBatch batch;
+        batch.supported = false;
+        if (batched && texture_format == WORLD_TEXTURE_RGBA)
+                batch = create_lattice_batch("resources/genericVertex.glsl", "resources/batchedFragment.glsl", &chicken);
+        else if (batched)
+                printf("--batched only draws RGBA textures, chunks are drawn one by one.\n");
+        if (batch.supported && gpu_culling)
+                lattice_batch_enable_gpu_culling(&batch, "resources/latticeCull.glsl", "resources/hizReduce.glsl", "resources/hizReproject.glsl");
+        if (batch.supported)
+                world.batch = &batch;
+
+        // the window covers every chunk world_update keeps resident
+        struct Clipmap clipmap;
+        clipmap.lattice.texture = 0;
+        if (clipmap_mode)
+        {
+                struct Lattice global;
+                if (create_demo_lattice(fragment_path, lattice_size*(2*view_distance+1), 0.1f, procedural, shared_planes, &global) == 0)
+                        clipmap = create_clipmap(global, lattice_size, 2*view_distance+1);
+                if (clipmap.lattice.texture != 0 && world_set_clipmap(&world, &clipmap) != 0)
+                        free_clipmap(&clipmap);
+        }
 
-        unsigned char * zxp = (unsigned char *) malloc(4*sizeof(char));
-        *(zxp) = 0xF0;
-        *(zxp+1) = 0x00;
-        *(zxp+2) = 0x5A;
-        *(zxp+3) = 0xFF;
+        // 32^3 slots of 8^3 voxels, as much as 64 chunks of 64^3 without a single uniform brick
+        struct BrickPool brick_pool;
+        brick_pool.texture = 0;
+        if (bricked)
+        {
+                brick_pool = create_brick_pool(32);
+                if (brick_pool.texture != 0 && world_set_brick_pool(&world, &brick_pool) != 0)
+                        free_brick_pool(&brick_pool);
+        }
 
-        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, lattice_size, lattice_size, lattice_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        float start_time = glfwGetTime();
 
+        world_update(&world, camera.position, view_distance);
 
-        unsigned char * test = (unsigned char *) malloc(chunk_data_size*4*sizeof(char));
+        printf("texture packer end time: %f\n",glfwGetTime()-start_time);
 
-        for (int i = 0 ; i < chunk_data_size ; i++)
+        struct WorldChunk* origin_chunk = world_get_chunk(&world, glm::ivec3(0,0,0));
+        if (origin_chunk != NULL)
         {
-                unsigned char * address = test+(i*4);
-                switch(*(chunk_data+i))
-                {
-                        case 0:
-                                *(address+0) = 0x00;
-                                *(address+1) = 0x00;
-                                *(address+2) = 0x00;
-                                *(address+3) = 0x00;
-                                break;
-                        case 1:
-                                *(address+0) = 0xDF;
-                                *(address+1) = 0x00;
-                                *(address+2) = 0xFF;
-                                *(address+3) = 0xFF;
-                                break;
-                        case 2:
-                                *(address+0) = 0xFF;
-                                *(address+1) = 0x00;
-                                *(address+2) = 0xFF;
-                                *(address+3) = 0xFF;
-                                break;
-
-                }
+                printf("size of chunk_data: %zu\n",world_chunk_memory_usage(&world, origin_chunk));
         }
+        // the corner markers are RGBA texels, index textures have no colour to write, and a
+        // brick pool or clipmap texture is shared with other chunks the markers would overwrite
+        if (origin_chunk != NULL && texture_format == WORLD_TEXTURE_RGBA && world.brick_pool == NULL && world.clipmap == NULL)
+        {
 
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, lattice_size-1, lattice_size-1, lattice_size-1, GL_RGBA, GL_UNSIGNED_BYTE, test);
-
-        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, origin);
+                unsigned char* origin = (unsigned char*) malloc(4*sizeof(char));
 
-        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, lattice_size-1, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, zp);
-       
-        glTexSubImage3D(GL_TEXTURE_3D, 0, lattice_size-1, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, xp);
+                *(origin) = 0xFF;
+                *(origin+1) = 0x00;
+                *(origin+2) = 0x00;
+                *(origin+3) = 0xFF;
+                
+                unsigned char* zp = (unsigned char* ) malloc(4*sizeof(char));
+                *(zp) = 0x00;
+                *(zp+1) = 0xFF;
+                *(zp+2) = 0x00;
+                *(zp+3) = 0xFF;
+
+                unsigned char * xp = (unsigned char *) malloc(4*sizeof(char));
+                *(xp) = 0x70;
+                *(xp+1) = 0xFF;
+                *(xp+2) = 0x00;
+                *(xp+3) = 0xFF;
+
+                unsigned char * zxp = (unsigned char *) malloc(4*sizeof(char));
+                *(zxp) = 0xF0;
+                *(zxp+1) = 0x00;
+                *(zxp+2) = 0x5A;
+                *(zxp+3) = 0xFF;
+
+                // mark the corners of the origin chunk to see the texture orientation
+                glBindTexture(GL_TEXTURE_3D, origin_chunk->lattice.texture);
+
+                glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, origin);
+
+                glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, lattice_size-1, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, zp);
+               
+                glTexSubImage3D(GL_TEXTURE_3D, 0, lattice_size-1, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, xp);
 
-        glTexSubImage3D(GL_TEXTURE_3D, 0, lattice_size-1, 0, lattice_size-1, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, zxp);
+                glTexSubImage3D(GL_TEXTURE_3D, 0, lattice_size-1, 0, lattice_size-1, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, zxp);
 
-        printf("texture packer end time: %f\n",glfwGetTime()-start_time);
+                glBindTexture(GL_TEXTURE_3D, 0);
 
-        glBindTexture(GL_TEXTURE_3D, 0);
-
-        free(origin);
-        free(zp);
-        free(xp);
-        free(stone);
-        free(zxp);
-        free(test);
+                free(origin);
+                free(zp);
+                free(xp);
+                free(zxp);
+        }
 
-        if (argc == 2){
+        if (wireframe){
 	    	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	    }
         
@@ -976,8 +408,6 @@ int main(int argc, char* argv[])
         glEnable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
 
-        glBindTexture(GL_TEXTURE_3D, lattice_chunk_albedo);
-
         double previous_frame_time,current_frame_time,frame_delta = 0.0f;
         unsigned int frame_count = 0;
 
@@ -1003,20 +433,43 @@ int main(int argc, char* argv[])
                 input_process(window, &camera, frame_delta);
 
                 camera_process(&camera);
+
+                world_update(&world, camera.position, view_distance);
+
+                // E clears the voxel just in front of the camera
+                if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+                {
+                        struct Voxel air = {0.0f, 0.0f, 0.0f, 0.0f, 0};
+                        world_set_voxel(&world, world_position_to_voxel(&world, camera.position+camera.front*0.5f), air);
+                }
+                // R turns every magenta voxel green, index textures only need their palettes uploaded again
+                if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+                {
+                        struct Voxel magenta = {1.0f, 0.0f, 1.0f, 1.0f, 0};
+                        struct Voxel green = {0.0f, 1.0f, 0.2f, 1.0f, 0};
+                        world_recolour(&world, magenta, green);
+                }
+                world_upload_edits(&world);
                 //printf("frame delta: %f ",frame_delta);
                 //printf("position, x: %f, y: %f, z: %f\n",camera.position.x, camera.position.y, camera.position.z);
                 /*printf("view matrix:\n");
                 print_mat4(camera.view);
                 printf("projection matrix:\n");
                 print_mat4(camera.projection);*/
-                draw_lattice(window, &chicken, &camera);
+                world_draw(window, &world, &camera);
 
 		        glfwSwapBuffers(window);
 
 		        glfwPollEvents();
 	    }
 
-        free(chunk_data);
+        free_world(&world);
+        if (world.clipmap != NULL)
+                free_clipmap(&clipmap);
+        if (world.brick_pool != NULL)
+                free_brick_pool(&brick_pool);
+        if (batch.supported)
+                free_lattice_batch(&batch);
 
         glfwTerminate();
 
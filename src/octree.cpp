@@ -0,0 +1,365 @@
+#include "octree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// deep enough for a 2^30 sized octree
+#define OCTREE_MAX_DEPTH 32
+
+
+struct Octree create_octree(int size, struct Voxel fill)
+{
+        struct Octree result;
+
+        result.size = size;
+        result.palette_capacity = 4;
+        result.palette_size = 1;
+        result.palette = (struct Voxel*) malloc(result.palette_capacity*sizeof(struct Voxel));
+        result.node_capacity = 64;
+        result.node_count = 1;
+        result.nodes = (struct OctreeNode*) malloc(result.node_capacity*sizeof(struct OctreeNode));
+        result.free_blocks = NULL;
+        result.free_block_count = 0;
+        result.free_block_capacity = 0;
+
+        if ((size & (size-1)) != 0)
+                printf("octree size %d is not a power of two.\n",size);
+
+        if (result.palette == NULL || result.nodes == NULL)
+        {
+                printf("Unable to allocate octree of size %d.\n",size);
+                free(result.palette);
+                free(result.nodes);
+                result.palette = NULL;
+                result.nodes = NULL;
+                result.palette_size = 0;
+                result.palette_capacity = 0;
+                result.node_count = 0;
+                result.node_capacity = 0;
+                return result;
+        }
+
+        *result.palette = fill;
+        result.nodes->children = -1;
+        result.nodes->value = 0;
+
+        return result;
+}
+
+
+void free_octree(struct Octree* octree)
+{
+        free(octree->palette);
+        free(octree->nodes);
+        free(octree->free_blocks);
+        octree->palette = NULL;
+        octree->nodes = NULL;
+        octree->free_blocks = NULL;
+        octree->palette_size = 0;
+        octree->palette_capacity = 0;
+        octree->node_count = 0;
+        octree->node_capacity = 0;
+        octree->free_block_count = 0;
+        octree->free_block_capacity = 0;
+}
+
+
+int octree_palette_index(struct Octree* octree, struct Voxel voxel)
+{
+        for (int i = 0 ; i < octree->palette_size ; i++)
+        {
+                if (voxel_equal(*(octree->palette+i), voxel))
+                        return i;
+        }
+
+        if (octree->palette_size == octree->palette_capacity)
+        {
+                int new_capacity = octree->palette_capacity*2;
+                struct Voxel* palette = (struct Voxel*) realloc(octree->palette, new_capacity*sizeof(struct Voxel));
+                if (palette == NULL)
+                {
+                        printf("Unable to grow octree palette.\n");
+                        return -1;
+                }
+                octree->palette = palette;
+                octree->palette_capacity = new_capacity;
+        }
+
+        *(octree->palette+octree->palette_size) = voxel;
+        octree->palette_size++;
+        return octree->palette_size-1;
+}
+
+
+// returns the first node of a fresh block of 8 leaves, -1 if the pool can't grow
+static int octree_allocate_block(struct Octree* octree, int value)
+{
+        int block;
+        if (octree->free_block_count > 0)
+        {
+                octree->free_block_count--;
+                block = *(octree->free_blocks+octree->free_block_count);
+        }
+        else
+        {
+                if (octree->node_count+8 > octree->node_capacity)
+                {
+                        int new_capacity = octree->node_capacity*2;
+                        struct OctreeNode* nodes = (struct OctreeNode*) realloc(octree->nodes, new_capacity*sizeof(struct OctreeNode));
+                        if (nodes == NULL)
+                        {
+                                printf("Unable to grow the octree node pool.\n");
+                                return -1;
+                        }
+                        octree->nodes = nodes;
+                        octree->node_capacity = new_capacity;
+                }
+                block = octree->node_count;
+                octree->node_count += 8;
+        }
+
+        for (int i = 0 ; i < 8 ; i++)
+        {
+                (octree->nodes+block+i)->children = -1;
+                (octree->nodes+block+i)->value = value;
+        }
+        return block;
+}
+
+
+static void octree_release_block(struct Octree* octree, int block)
+{
+        if (octree->free_block_count == octree->free_block_capacity)
+        {
+                int new_capacity = octree->free_block_capacity == 0 ? 16 : octree->free_block_capacity*2;
+                int* free_blocks = (int*) realloc(octree->free_blocks, new_capacity*sizeof(int));
+                if (free_blocks == NULL)
+                {
+                        // the block just leaks into the pool until the octree is freed
+                        return;
+                }
+                octree->free_blocks = free_blocks;
+                octree->free_block_capacity = new_capacity;
+        }
+        *(octree->free_blocks+octree->free_block_count) = block;
+        octree->free_block_count++;
+}
+
+
+// turns node into a leaf if all of its children are leaves with the same value
+static int octree_try_collapse(struct Octree* octree, int node)
+{
+        int block = (octree->nodes+node)->children;
+        int value = (octree->nodes+block)->value;
+        for (int i = 0 ; i < 8 ; i++)
+        {
+                struct OctreeNode* child = octree->nodes+block+i;
+                if (child->children != -1 || child->value != value)
+                        return 0;
+        }
+
+        (octree->nodes+node)->children = -1;
+        (octree->nodes+node)->value = value;
+        octree_release_block(octree, block);
+        return 1;
+}
+
+
+int octree_get_index(const struct Octree* octree, int x, int y, int z)
+{
+        int node = 0;
+        int half = octree->size/2;
+        while ((octree->nodes+node)->children != -1)
+        {
+                int child = ((x & half) ? 1 : 0) | ((y & half) ? 2 : 0) | ((z & half) ? 4 : 0);
+                node = (octree->nodes+node)->children+child;
+                half /= 2;
+        }
+        return (octree->nodes+node)->value;
+}
+
+
+struct Voxel octree_get(const struct Octree* octree, int x, int y, int z)
+{
+        return *(octree->palette+octree_get_index(octree, x, y, z));
+}
+
+
+int octree_set_index(struct Octree* octree, int x, int y, int z, int palette_index)
+{
+        int path[OCTREE_MAX_DEPTH];
+        int depth = 0;
+        int node = 0;
+        int half = octree->size/2;
+
+        while (half > 0)
+        {
+                if ((octree->nodes+node)->children == -1)
+                {
+                        if ((octree->nodes+node)->value == palette_index)
+                                return 0;
+                        int block = octree_allocate_block(octree, (octree->nodes+node)->value);
+                        if (block == -1)
+                                return -1;
+                        (octree->nodes+node)->children = block;
+                }
+                path[depth++] = node;
+                int child = ((x & half) ? 1 : 0) | ((y & half) ? 2 : 0) | ((z & half) ? 4 : 0);
+                node = (octree->nodes+node)->children+child;
+                half /= 2;
+        }
+
+        (octree->nodes+node)->value = palette_index;
+
+        // collapse back up as long as the siblings agree
+        while (depth > 0)
+        {
+                depth--;
+                if (!octree_try_collapse(octree, path[depth]))
+                        break;
+        }
+        return 0;
+}
+
+
+int octree_set(struct Octree* octree, int x, int y, int z, struct Voxel voxel)
+{
+        int palette_index = octree_palette_index(octree, voxel);
+        if (palette_index == -1)
+                return -1;
+        return octree_set_index(octree, x, y, z, palette_index);
+}
+
+
+void octree_fill(struct Octree* octree, struct Voxel voxel)
+{
+        octree->node_count = 1;
+        octree->free_block_count = 0;
+        octree->nodes->children = -1;
+        octree->nodes->value = 0;
+        *octree->palette = voxel;
+        octree->palette_size = 1;
+}
+
+
+// remap turns chunk palette indices into octree palette indices
+static void octree_build(struct Octree* octree, const struct Chunk* chunk, const int* remap, int node, int x, int y, int z, int size)
+{
+        if (size == 1)
+        {
+                (octree->nodes+node)->value = *(remap+chunk_get_index(chunk, x, y, z));
+                return;
+        }
+
+        int block = octree_allocate_block(octree, 0);
+        if (block == -1)
+                return;
+        // the pool may have moved, so only touch the node through its index
+        (octree->nodes+node)->children = block;
+
+        int half = size/2;
+        for (int i = 0 ; i < 8 ; i++)
+                octree_build(octree, chunk, remap, block+i, x+((i&1) ? half : 0), y+((i&2) ? half : 0), z+((i&4) ? half : 0), half);
+
+        octree_try_collapse(octree, node);
+}
+
+
+struct Octree octree_from_chunk(const struct Chunk* chunk)
+{
+        struct Octree result = create_octree(chunk->size, *chunk->palette);
+        if (result.nodes == NULL)
+                return result;
+
+        // equal chunk palette entries share one octree entry, so indices go through remap
+        int* remap = (int*) malloc(chunk->palette_size*sizeof(int));
+        if (remap == NULL)
+        {
+                printf("Unable to allocate the octree palette remap.\n");
+                free_octree(&result);
+                return result;
+        }
+        for (int i = 0 ; i < chunk->palette_size ; i++)
+        {
+                *(remap+i) = octree_palette_index(&result, *(chunk->palette+i));
+                if (*(remap+i) == -1)
+                {
+                        free(remap);
+                        free_octree(&result);
+                        return result;
+                }
+        }
+
+        octree_build(&result, chunk, remap, 0, 0, 0, 0, chunk->size);
+        free(remap);
+        return result;
+}
+
+
+size_t octree_memory_usage(const struct Octree* octree)
+{
+        return sizeof(struct Octree) + octree->palette_capacity*sizeof(struct Voxel)
+                + octree->node_capacity*sizeof(struct OctreeNode) + octree->free_block_capacity*sizeof(int);
+}
+
+
+typedef struct OctreeRegion
+{
+        int x, y, z;
+        int width, height, depth;
+        unsigned char* out;
+        const uint32_t* colours;
+}OctreeRegion;
+
+
+static void octree_extract_node(const struct Octree* octree, const struct OctreeRegion* region, int node, int x, int y, int z, int size)
+{
+        int x0 = x > region->x ? x : region->x;
+        int y0 = y > region->y ? y : region->y;
+        int z0 = z > region->z ? z : region->z;
+        int x1 = x+size < region->x+region->width ? x+size : region->x+region->width;
+        int y1 = y+size < region->y+region->height ? y+size : region->y+region->height;
+        int z1 = z+size < region->z+region->depth ? z+size : region->z+region->depth;
+        if (x0 >= x1 || y0 >= y1 || z0 >= z1)
+                return;
+
+        const struct OctreeNode* current = octree->nodes+node;
+        if (current->children == -1)
+        {
+                uint32_t texel = *(region->colours+current->value);
+                for (int k = z0 ; k < z1 ; k++)
+                {
+                        for (int j = y0 ; j < y1 ; j++)
+                        {
+                                size_t row = ((size_t)(k-region->z)*region->height + (j-region->y))*region->width;
+                                unsigned char* address = region->out+(row+(x0-region->x))*4;
+                                for (int i = x0 ; i < x1 ; i++, address += 4)
+                                        memcpy(address, &texel, sizeof(texel));
+                        }
+                }
+                return;
+        }
+
+        int half = size/2;
+        for (int i = 0 ; i < 8 ; i++)
+                octree_extract_node(octree, region, current->children+i, x+((i&1) ? half : 0), y+((i&2) ? half : 0), z+((i&4) ? half : 0), half);
+}
+
+
+void octree_extract_region(const struct Octree* octree, int x, int y, int z, int width, int height, int depth, unsigned char* out)
+{
+        uint32_t* colours = (uint32_t*) malloc(octree->palette_size*sizeof(uint32_t));
+        if (colours == NULL)
+        {
+                printf("Unable to allocate the octree colour table.\n");
+                return;
+        }
+        for (int i = 0 ; i < octree->palette_size ; i++)
+                *(colours+i) = voxel_to_rgba(*(octree->palette+i));
+
+        struct OctreeRegion region = {x, y, z, width, height, depth, out, colours};
+        octree_extract_node(octree, &region, 0, 0, 0, 0, octree->size);
+
+        free(colours);
+}
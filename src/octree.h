@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chunk.h"
+
+// A node is either a uniform leaf holding a palette index or a branch whose
+// 8 children are stored next to each other in the node pool.
+// child order is x in bit 0, y in bit 1, z in bit 2
+typedef struct OctreeNode
+{
+        // index of the first child in the node pool, -1 for a leaf
+        int children;
+        // palette index of a leaf, unused for branches
+        int value;
+}OctreeNode;
+
+
+// Sparse voxel octree alternative to the palette Chunk.
+// Any region of uniform voxels collapses into a single leaf so memory follows
+// the surface area of a chunk instead of its volume.
+// size has to be a power of two, voxels use the same x, y, z addressing as Chunk.
+typedef struct Octree
+{
+        int size;
+        struct Voxel* palette;
+        int palette_size;
+        int palette_capacity;
+        // node 0 is the root
+        struct OctreeNode* nodes;
+        int node_count;
+        int node_capacity;
+        // first node of every 8 node block released by collapsing
+        int* free_blocks;
+        int free_block_count;
+        int free_block_capacity;
+}Octree;
+
+
+struct Octree create_octree(int size, struct Voxel fill);
+void free_octree(struct Octree* octree);
+
+// returns the palette index of voxel, adding it when it is new
+int octree_palette_index(struct Octree* octree, struct Voxel voxel);
+
+int octree_get_index(const struct Octree* octree, int x, int y, int z);
+struct Voxel octree_get(const struct Octree* octree, int x, int y, int z);
+// both return -1 and leave the voxel alone if a node block or palette entry can't be allocated
+int octree_set_index(struct Octree* octree, int x, int y, int z, int palette_index);
+int octree_set(struct Octree* octree, int x, int y, int z, struct Voxel voxel);
+void octree_fill(struct Octree* octree, struct Voxel voxel);
+
+// builds an octree holding the same voxels as chunk, chunk->size has to be a power of two,
+// equal palette entries of chunk are merged. nodes is NULL if it couldn't be built
+struct Octree octree_from_chunk(const struct Chunk* chunk);
+
+size_t octree_memory_usage(const struct Octree* octree);
+
+// writes the RGBA8 texels of the width*height*depth box starting at x,y,z to out,
+// uniform nodes are filled as whole boxes rather than visited per voxel
+void octree_extract_region(const struct Octree* octree, int x, int y, int z, int width, int height, int depth, unsigned char* out);
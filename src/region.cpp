@@ -0,0 +1,320 @@
+#include "region.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "codec.h"
+#include "int_math.h"
+
+#define REGION_VERSION 1
+#define REGION_TABLE_SECTOR 1
+#define REGION_TABLE_SECTORS ((REGION_CHUNK_COUNT*sizeof(struct RegionEntry)+REGION_SECTOR_SIZE-1)/REGION_SECTOR_SIZE)
+#define REGION_FIRST_PAYLOAD_SECTOR (REGION_TABLE_SECTOR+REGION_TABLE_SECTORS)
+// the file grows by at least this many sectors so saves don't remap every time
+#define REGION_GROWTH_SECTORS 256
+
+
+glm::ivec3 region_of_chunk(glm::ivec3 chunk)
+{
+        return glm::ivec3(floor_divide(chunk.x, REGION_SIZE), floor_divide(chunk.y, REGION_SIZE), floor_divide(chunk.z, REGION_SIZE));
+}
+
+
+static int region_entry_index(const struct Region* region, glm::ivec3 chunk)
+{
+        glm::ivec3 local = chunk - region->position*REGION_SIZE;
+        return local.x + REGION_SIZE*(local.y + REGION_SIZE*local.z);
+}
+
+
+static struct RegionHeader* region_header(const struct Region* region)
+{
+        return (struct RegionHeader*) region->map;
+}
+
+
+static struct RegionEntry* region_entry(const struct Region* region, int index)
+{
+        return ((struct RegionEntry*) (region->map+REGION_TABLE_SECTOR*REGION_SECTOR_SIZE))+index;
+}
+
+
+// maps size bytes of the file, the old mapping is only replaced once the new one exists
+// so a region that fails to grow keeps working at its old size
+static int region_map(struct Region* region, size_t size)
+{
+        void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, region->file, 0);
+        if (map == MAP_FAILED)
+                return -1;
+
+        if (region->map != NULL)
+                munmap(region->map, region->map_size);
+        region->map = (unsigned char*) map;
+        region->map_size = size;
+        return 0;
+}
+
+
+// rebuilds which sectors the header, the chunk table and the saved chunks take up
+static void region_mark_sectors(struct Region* region)
+{
+        size_t mapped_sectors = region->map_size/REGION_SECTOR_SIZE;
+        region->sectors_used.assign(region_header(region)->sector_count, false);
+        for (size_t sector = 0 ; sector < REGION_FIRST_PAYLOAD_SECTOR ; sector++)
+                region->sectors_used[sector] = true;
+
+        for (int i = 0 ; i < REGION_CHUNK_COUNT ; i++)
+        {
+                const struct RegionEntry* entry = region_entry(region, i);
+                size_t end = (size_t)entry->sector_offset+entry->sector_count;
+                // loading rejects chunks past the end of the file, they don't hold on to anything
+                if (entry->length == 0 || end > mapped_sectors)
+                        continue;
+                if (end > region->sectors_used.size())
+                        region->sectors_used.resize(end, false);
+                for (size_t sector = entry->sector_offset ; sector < end ; sector++)
+                        region->sectors_used[sector] = true;
+        }
+}
+
+
+// First sector of the first run of count free sectors, the sectors of own count as free.
+// Without such a run, the run starts at the free sectors at the end, or past every used sector.
+static uint32_t region_find_sectors(const struct Region* region, uint32_t count, const struct RegionEntry* own)
+{
+        uint32_t end = (uint32_t)region->sectors_used.size();
+        uint32_t run = 0;
+        for (uint32_t sector = REGION_FIRST_PAYLOAD_SECTOR ; sector < end ; sector++)
+        {
+                bool owned = own->length != 0 && sector >= own->sector_offset && sector < own->sector_offset+own->sector_count;
+                if (region->sectors_used[sector] && !owned)
+                {
+                        run = 0;
+                        continue;
+                }
+                if (++run == count)
+                        return sector+1-count;
+        }
+        return end-run;
+}
+
+
+int open_region(const char* path, glm::ivec3 position, int chunk_size, struct Region* out)
+{
+        struct Region result;
+        result.position = position;
+        result.chunk_size = chunk_size;
+        result.map = NULL;
+        result.map_size = 0;
+
+        result.file = open(path, O_RDWR | O_CREAT, 0644);
+        if (result.file == -1)
+        {
+                printf("Unable to open region file at: %s\n",path);
+                return -1;
+        }
+
+        struct stat file_stat;
+        if (fstat(result.file, &file_stat) != 0)
+        {
+                printf("Unable to stat region file at: %s\n",path);
+                close(result.file);
+                return -1;
+        }
+
+        size_t header_size = REGION_FIRST_PAYLOAD_SECTOR*REGION_SECTOR_SIZE;
+        bool created = file_stat.st_size == 0;
+        if (created)
+        {
+                // ftruncate zero fills, which is an empty chunk table
+                if (ftruncate(result.file, header_size) != 0)
+                {
+                        printf("Unable to size region file at: %s\n",path);
+                        close(result.file);
+                        return -1;
+                }
+                file_stat.st_size = header_size;
+        }
+        else if ((size_t)file_stat.st_size < header_size)
+        {
+                printf("region file at %s is truncated.\n",path);
+                close(result.file);
+                return -1;
+        }
+
+        if (region_map(&result, file_stat.st_size) != 0)
+        {
+                printf("Unable to map region file at: %s\n",path);
+                close(result.file);
+                return -1;
+        }
+
+        struct RegionHeader* header = region_header(&result);
+        if (created)
+        {
+                memcpy(header->magic, "LREG", 4);
+                header->version = REGION_VERSION;
+                header->chunk_size = chunk_size;
+                header->sector_count = REGION_FIRST_PAYLOAD_SECTOR;
+        }
+        else if (memcmp(header->magic, "LREG", 4) != 0 || header->version != REGION_VERSION || (int)header->chunk_size != chunk_size
+                 || (size_t)header->sector_count*REGION_SECTOR_SIZE > result.map_size)
+        {
+                printf("region file at %s doesn't match this world.\n",path);
+                close_region(&result);
+                return -1;
+        }
+
+        region_mark_sectors(&result);
+
+        *out = result;
+        return 0;
+}
+
+
+void close_region(struct Region* region)
+{
+        if (region->map != NULL)
+                munmap(region->map, region->map_size);
+        if (region->file != -1)
+                close(region->file);
+        region->map = NULL;
+        region->map_size = 0;
+        region->file = -1;
+}
+
+
+int region_has_chunk(const struct Region* region, glm::ivec3 chunk)
+{
+        return region_entry(region, region_entry_index(region, chunk))->length != 0;
+}
+
+
+int region_load_chunk(const struct Region* region, glm::ivec3 chunk, struct Chunk* out)
+{
+        const struct RegionEntry* entry = region_entry(region, region_entry_index(region, chunk));
+        if (entry->length == 0)
+                return -1;
+
+        size_t offset = (size_t)entry->sector_offset*REGION_SECTOR_SIZE;
+        if (offset+entry->length > region->map_size)
+        {
+                printf("region %d %d %d has a chunk past the end of the file.\n",region->position.x,region->position.y,region->position.z);
+                return -1;
+        }
+
+        const unsigned char* payload = region->map+offset;
+        size_t length = entry->length;
+        unsigned char* decompressed = NULL;
+        if (entry->flags & REGION_ENTRY_COMPRESSED)
+        {
+                // the length comes from the file, nothing larger than a chunk is allocated for it
+                length = codec_decompressed_size(payload, entry->length);
+                if (length > chunk_max_serialized_size(region->chunk_size))
+                {
+                        printf("region %d %d %d holds a corrupt chunk.\n",region->position.x,region->position.y,region->position.z);
+                        return -1;
+                }
+                decompressed = (unsigned char*) malloc(length);
+                if (decompressed == NULL || codec_decompress(payload, entry->length, decompressed, length) != 0)
+                {
+                        printf("region %d %d %d holds a corrupt chunk.\n",region->position.x,region->position.y,region->position.z);
+                        free(decompressed);
+                        return -1;
+                }
+                payload = decompressed;
+        }
+
+        int result = chunk_deserialize(payload, length, region->chunk_size, out);
+        free(decompressed);
+        if (result != 0)
+        {
+                printf("region %d %d %d holds a corrupt chunk.\n",region->position.x,region->position.y,region->position.z);
+                return -1;
+        }
+        return 0;
+}
+
+
+int region_save_chunk(struct Region* region, glm::ivec3 chunk, const struct Chunk* data)
+{
+        int index = region_entry_index(region, chunk);
+        size_t serialized_size = chunk_serialized_size(data);
+        unsigned char* serialized = (unsigned char*) malloc(serialized_size);
+        unsigned char* compressed = (unsigned char*) malloc(codec_compress_bound(serialized_size));
+        if (serialized == NULL || compressed == NULL)
+        {
+                printf("Unable to allocate the save buffers of region %d %d %d.\n",region->position.x,region->position.y,region->position.z);
+                free(serialized);
+                free(compressed);
+                return -1;
+        }
+        chunk_serialize(data, serialized);
+
+        // packed indices repeat whole words, which the plain LZ pass already catches, so no delta
+        const unsigned char* payload = serialized;
+        size_t length = serialized_size;
+        uint32_t flags = 0;
+        size_t compressed_size = codec_compress(serialized, serialized_size, compressed);
+        if (compressed_size != 0 && compressed_size < serialized_size)
+        {
+                payload = compressed;
+                length = compressed_size;
+                flags = REGION_ENTRY_COMPRESSED;
+        }
+
+        uint32_t sectors = (length+REGION_SECTOR_SIZE-1)/REGION_SECTOR_SIZE;
+
+        struct RegionEntry previous = *region_entry(region, index);
+        struct RegionEntry entry = previous;
+        // the chunk stays in place while it fits, letting go of the sectors it no longer needs
+        if (entry.length == 0 || entry.sector_count < sectors)
+                entry.sector_offset = region_find_sectors(region, sectors, &previous);
+        entry.sector_count = sectors;
+        uint32_t used_sectors = region_header(region)->sector_count;
+        if (entry.sector_offset+sectors > used_sectors)
+                used_sectors = entry.sector_offset+sectors;
+
+        size_t required_size = (size_t)used_sectors*REGION_SECTOR_SIZE;
+        if (required_size > region->map_size)
+        {
+                size_t new_size = region->map_size+REGION_GROWTH_SECTORS*REGION_SECTOR_SIZE;
+                if (new_size < required_size)
+                        new_size = required_size;
+                if (ftruncate(region->file, new_size) != 0 || region_map(region, new_size) != 0)
+                {
+                        // the old mapping is still in place, the file goes back to its size
+                        if (ftruncate(region->file, region->map_size) != 0)
+                                printf("Unable to shrink region file %d %d %d back.\n",region->position.x,region->position.y,region->position.z);
+                        printf("Unable to grow region file %d %d %d.\n",region->position.x,region->position.y,region->position.z);
+                        free(serialized);
+                        free(compressed);
+                        return -1;
+                }
+        }
+
+        memcpy(region->map+(size_t)entry.sector_offset*REGION_SECTOR_SIZE, payload, length);
+        free(serialized);
+        free(compressed);
+        entry.length = length;
+        entry.flags = flags;
+        *region_entry(region, index) = entry;
+
+        if (used_sectors > region->sectors_used.size())
+                region->sectors_used.resize(used_sectors, false);
+        for (uint32_t sector = previous.sector_offset ; previous.length != 0 && sector < previous.sector_offset+previous.sector_count && sector < used_sectors ; sector++)
+                region->sectors_used[sector] = false;
+        for (uint32_t sector = entry.sector_offset ; sector < entry.sector_offset+entry.sector_count ; sector++)
+                region->sectors_used[sector] = true;
+        // free sectors at the end are handed out again before the file grows
+        while (used_sectors > REGION_FIRST_PAYLOAD_SECTOR && !region->sectors_used[used_sectors-1])
+                used_sectors--;
+        region->sectors_used.resize(used_sectors);
+        region_header(region)->sector_count = used_sectors;
+        return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include <vector>
+
+#include "chunk.h"
+
+// chunks per region along each axis
+#define REGION_SIZE 16
+#define REGION_CHUNK_COUNT (REGION_SIZE*REGION_SIZE*REGION_SIZE)
+#define REGION_SECTOR_SIZE 4096
+
+
+// sector 0 of a region file
+typedef struct RegionHeader
+{
+        char magic[4];
+        uint32_t version;
+        uint32_t chunk_size;
+        // sectors in use including the header and the chunk table
+        uint32_t sector_count;
+}RegionHeader;
+
+
+// the payload is a codec stream of the serialized chunk
+#define REGION_ENTRY_COMPRESSED 1
+
+
+// chunk table entry, a length of 0 means the chunk was never saved
+typedef struct RegionEntry
+{
+        uint32_t sector_offset;
+        uint32_t sector_count;
+        uint32_t length;
+        uint32_t flags;
+}RegionEntry;
+
+
+// A region file holds REGION_SIZE^3 chunks.
+// The file is a header sector, a fixed chunk table and sector aligned chunk payloads.
+// It is mapped into memory as a whole, loading a chunk copies (or decompresses) straight
+// out of the mapping so the only IO is the page faults for the sectors actually touched.
+// Chunks are stored compressed whenever the codec makes them smaller.
+// A chunk that outgrows its sectors moves to the first run of free sectors that fits it,
+// so the sectors it leaves behind are reused by later saves.
+typedef struct Region
+{
+        glm::ivec3 position;
+        int chunk_size;
+        int file;
+        unsigned char* map;
+        size_t map_size;
+        // one entry per sector up to the header's sector_count, built from the chunk table on open
+        std::vector<bool> sectors_used;
+}Region;
+
+
+// region coordinate containing a chunk coordinate
+glm::ivec3 region_of_chunk(glm::ivec3 chunk);
+
+// opens or creates the region file at path, returns -1 on failure
+int open_region(const char* path, glm::ivec3 position, int chunk_size, struct Region* out);
+void close_region(struct Region* region);
+
+// chunk is a world chunk coordinate inside the region
+int region_has_chunk(const struct Region* region, glm::ivec3 chunk);
+// returns -1 if the chunk isn't stored in the region
+int region_load_chunk(const struct Region* region, glm::ivec3 chunk, struct Chunk* out);
+int region_save_chunk(struct Region* region, glm::ivec3 chunk, const struct Chunk* data);
@@ -0,0 +1,319 @@
+#include "rle_chunk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static int rle_column_reset(struct RleColumn* column, int value)
+{
+        if (column->run_capacity == 0)
+        {
+                column->runs = (struct RleRun*) malloc(2*sizeof(struct RleRun));
+                if (column->runs == NULL)
+                        return -1;
+                column->run_capacity = 2;
+        }
+        column->runs->start = 0;
+        column->runs->value = value;
+        column->run_count = 1;
+        return 0;
+}
+
+
+struct RleChunk create_rle_chunk(int size, struct Voxel fill)
+{
+        struct RleChunk result;
+
+        result.size = size;
+        result.palette_capacity = 4;
+        result.palette_size = 1;
+        result.palette = (struct Voxel*) malloc(result.palette_capacity*sizeof(struct Voxel));
+        result.columns = (struct RleColumn*) calloc((size_t)size*size, sizeof(struct RleColumn));
+
+        if (size > 0xFFFF)
+                printf("rle chunk size %d doesn't fit 16 bit run starts.\n",size);
+
+        if (result.palette == NULL || result.columns == NULL)
+        {
+                printf("Unable to allocate rle chunk of size %d.\n",size);
+                free(result.palette);
+                free(result.columns);
+                result.palette = NULL;
+                result.columns = NULL;
+                result.palette_size = 0;
+                result.palette_capacity = 0;
+                return result;
+        }
+
+        *result.palette = fill;
+        for (size_t i = 0 ; i < (size_t)size*size ; i++)
+        {
+                if (rle_column_reset(result.columns+i, 0) != 0)
+                {
+                        printf("Unable to allocate rle chunk columns.\n");
+                        break;
+                }
+        }
+
+        return result;
+}
+
+
+void free_rle_chunk(struct RleChunk* chunk)
+{
+        if (chunk->columns != NULL)
+        {
+                for (size_t i = 0 ; i < (size_t)chunk->size*chunk->size ; i++)
+                        free((chunk->columns+i)->runs);
+        }
+        free(chunk->columns);
+        free(chunk->palette);
+        chunk->columns = NULL;
+        chunk->palette = NULL;
+        chunk->palette_size = 0;
+        chunk->palette_capacity = 0;
+}
+
+
+int rle_chunk_palette_index(struct RleChunk* chunk, struct Voxel voxel)
+{
+        for (int i = 0 ; i < chunk->palette_size ; i++)
+        {
+                if (voxel_equal(*(chunk->palette+i), voxel))
+                        return i;
+        }
+
+        if (chunk->palette_size > 0xFFFF)
+        {
+                printf("rle chunk palette is full, unable to add a new voxel type.\n");
+                return -1;
+        }
+
+        if (chunk->palette_size == chunk->palette_capacity)
+        {
+                int new_capacity = chunk->palette_capacity*2;
+                struct Voxel* palette = (struct Voxel*) realloc(chunk->palette, new_capacity*sizeof(struct Voxel));
+                if (palette == NULL)
+                {
+                        printf("Unable to grow rle chunk palette.\n");
+                        return -1;
+                }
+                chunk->palette = palette;
+                chunk->palette_capacity = new_capacity;
+        }
+
+        *(chunk->palette+chunk->palette_size) = voxel;
+        chunk->palette_size++;
+        return chunk->palette_size-1;
+}
+
+
+// index of the run containing y
+static int rle_column_find(const struct RleColumn* column, int y)
+{
+        int low = 0;
+        int high = column->run_count-1;
+        while (low < high)
+        {
+                int middle = (low+high+1)/2;
+                if ((column->runs+middle)->start <= y)
+                        low = middle;
+                else
+                        high = middle-1;
+        }
+        return low;
+}
+
+
+static int rle_column_insert(struct RleColumn* column, int index, int start, int value)
+{
+        if (column->run_count == column->run_capacity)
+        {
+                int new_capacity = column->run_capacity*2;
+                struct RleRun* runs = (struct RleRun*) realloc(column->runs, new_capacity*sizeof(struct RleRun));
+                if (runs == NULL)
+                {
+                        printf("Unable to grow rle column.\n");
+                        return -1;
+                }
+                column->runs = runs;
+                column->run_capacity = new_capacity;
+        }
+        memmove(column->runs+index+1, column->runs+index, (column->run_count-index)*sizeof(struct RleRun));
+        (column->runs+index)->start = start;
+        (column->runs+index)->value = value;
+        column->run_count++;
+        return 0;
+}
+
+
+static void rle_column_remove(struct RleColumn* column, int index)
+{
+        memmove(column->runs+index, column->runs+index+1, (column->run_count-index-1)*sizeof(struct RleRun));
+        column->run_count--;
+}
+
+
+int rle_chunk_get_index(const struct RleChunk* chunk, int x, int y, int z)
+{
+        const struct RleColumn* column = chunk->columns+x+(size_t)z*chunk->size;
+        return (column->runs+rle_column_find(column, y))->value;
+}
+
+
+struct Voxel rle_chunk_get(const struct RleChunk* chunk, int x, int y, int z)
+{
+        return *(chunk->palette+rle_chunk_get_index(chunk, x, y, z));
+}
+
+
+int rle_chunk_set_index(struct RleChunk* chunk, int x, int y, int z, int palette_index)
+{
+        struct RleColumn* column = chunk->columns+x+(size_t)z*chunk->size;
+        int run = rle_column_find(column, y);
+        int old_value = (column->runs+run)->value;
+        if (old_value == palette_index)
+                return 0;
+
+        int start = (column->runs+run)->start;
+        int end = run+1 < column->run_count ? (column->runs+run+1)->start : chunk->size;
+
+        // split the run so y sits in a run of its own
+        if (y+1 < end)
+        {
+                if (rle_column_insert(column, run+1, y+1, old_value) != 0)
+                        return -1;
+        }
+        if (y > start)
+        {
+                if (rle_column_insert(column, run+1, y, palette_index) != 0)
+                        return -1;
+                run++;
+        }
+        else
+                (column->runs+run)->value = palette_index;
+
+        // merge with the neighbours if they now hold the same value
+        if (run+1 < column->run_count && (column->runs+run+1)->value == palette_index)
+                rle_column_remove(column, run+1);
+        if (run > 0 && (column->runs+run-1)->value == palette_index)
+                rle_column_remove(column, run);
+        return 0;
+}
+
+
+int rle_chunk_set(struct RleChunk* chunk, int x, int y, int z, struct Voxel voxel)
+{
+        int palette_index = rle_chunk_palette_index(chunk, voxel);
+        if (palette_index == -1)
+                return -1;
+        return rle_chunk_set_index(chunk, x, y, z, palette_index);
+}
+
+
+void rle_chunk_fill(struct RleChunk* chunk, struct Voxel voxel)
+{
+        for (size_t i = 0 ; i < (size_t)chunk->size*chunk->size ; i++)
+                rle_column_reset(chunk->columns+i, 0);
+        *chunk->palette = voxel;
+        chunk->palette_size = 1;
+}
+
+
+const struct RleColumn* rle_chunk_column(const struct RleChunk* chunk, int x, int z)
+{
+        return chunk->columns+x+(size_t)z*chunk->size;
+}
+
+
+struct RleChunk rle_chunk_from_chunk(const struct Chunk* chunk)
+{
+        struct RleChunk result = create_rle_chunk(chunk->size, *chunk->palette);
+        if (result.columns == NULL)
+                return result;
+
+        // equal chunk palette entries share one rle entry, so run values go through remap
+        int* remap = (int*) malloc(chunk->palette_size*sizeof(int));
+        if (remap == NULL)
+        {
+                printf("Unable to allocate the rle chunk palette remap.\n");
+                free_rle_chunk(&result);
+                return result;
+        }
+        for (int i = 0 ; i < chunk->palette_size ; i++)
+        {
+                *(remap+i) = rle_chunk_palette_index(&result, *(chunk->palette+i));
+                if (*(remap+i) == -1)
+                {
+                        free(remap);
+                        free_rle_chunk(&result);
+                        return result;
+                }
+        }
+
+        for (int z = 0 ; z < chunk->size ; z++)
+        {
+                for (int x = 0 ; x < chunk->size ; x++)
+                {
+                        struct RleColumn* column = result.columns+x+(size_t)z*chunk->size;
+                        int value = *(remap+chunk_get_index(chunk, x, 0, z));
+                        (column->runs)->value = value;
+                        for (int y = 1 ; y < chunk->size ; y++)
+                        {
+                                int next = *(remap+chunk_get_index(chunk, x, y, z));
+                                if (next == value)
+                                        continue;
+                                if (rle_column_insert(column, column->run_count, y, next) != 0)
+                                        break;
+                                value = next;
+                        }
+                }
+        }
+
+        free(remap);
+        return result;
+}
+
+
+size_t rle_chunk_memory_usage(const struct RleChunk* chunk)
+{
+        size_t result = sizeof(struct RleChunk) + chunk->palette_capacity*sizeof(struct Voxel);
+        for (size_t i = 0 ; i < (size_t)chunk->size*chunk->size ; i++)
+                result += sizeof(struct RleColumn) + (chunk->columns+i)->run_capacity*sizeof(struct RleRun);
+        return result;
+}
+
+
+void rle_chunk_decode_rgba(const struct RleChunk* chunk, int z_begin, int z_end, unsigned char* out)
+{
+        uint32_t* colours = (uint32_t*) malloc(chunk->palette_size*sizeof(uint32_t));
+        if (colours == NULL)
+        {
+                printf("Unable to allocate the rle chunk colour table.\n");
+                return;
+        }
+        for (int i = 0 ; i < chunk->palette_size ; i++)
+                *(colours+i) = voxel_to_rgba(*(chunk->palette+i));
+
+        // one z slice of texels stays in cache while every column of it is filled run by run
+        size_t row_stride = (size_t)chunk->size*4;
+        for (int z = z_begin ; z < z_end ; z++)
+        {
+                unsigned char* slice = out+(size_t)(z-z_begin)*chunk->size*row_stride;
+                for (int x = 0 ; x < chunk->size ; x++)
+                {
+                        const struct RleColumn* column = chunk->columns+x+(size_t)z*chunk->size;
+                        unsigned char* address = slice+x*4;
+                        for (int r = 0 ; r < column->run_count ; r++)
+                        {
+                                int end = r+1 < column->run_count ? (column->runs+r+1)->start : chunk->size;
+                                uint32_t texel = *(colours+(column->runs+r)->value);
+                                for (int y = (column->runs+r)->start ; y < end ; y++, address += row_stride)
+                                        memcpy(address, &texel, sizeof(texel));
+                        }
+                }
+        }
+
+        free(colours);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chunk.h"
+
+// a run covers y from start up to the start of the next run (or the top of the column)
+typedef struct RleRun
+{
+        uint16_t start;
+        uint16_t value;
+}RleRun;
+
+
+typedef struct RleColumn
+{
+        struct RleRun* runs;
+        int run_count;
+        int run_capacity;
+}RleColumn;
+
+
+// Chunk stored as run length encoded columns along the Y axis.
+// Natural terrain is a handful of long runs per column (stone, dirt, air) so
+// this is far smaller than one index per voxel and decodes as a few fills.
+// Runs in a column are sorted by start so random access is a binary search.
+// columns are addressed x + z*size, voxels use the same x, y, z addressing as Chunk.
+typedef struct RleChunk
+{
+        int size;
+        struct Voxel* palette;
+        int palette_size;
+        int palette_capacity;
+        struct RleColumn* columns;
+}RleChunk;
+
+
+struct RleChunk create_rle_chunk(int size, struct Voxel fill);
+void free_rle_chunk(struct RleChunk* chunk);
+
+// returns the palette index of voxel, adding it when it is new
+int rle_chunk_palette_index(struct RleChunk* chunk, struct Voxel voxel);
+
+int rle_chunk_get_index(const struct RleChunk* chunk, int x, int y, int z);
+struct Voxel rle_chunk_get(const struct RleChunk* chunk, int x, int y, int z);
+// both return -1 and leave the voxel alone if a run or palette entry can't be allocated
+int rle_chunk_set_index(struct RleChunk* chunk, int x, int y, int z, int palette_index);
+int rle_chunk_set(struct RleChunk* chunk, int x, int y, int z, struct Voxel voxel);
+void rle_chunk_fill(struct RleChunk* chunk, struct Voxel voxel);
+
+// direct access to the runs of a column for iteration
+const struct RleColumn* rle_chunk_column(const struct RleChunk* chunk, int x, int z);
+
+// equal palette entries of chunk are merged, columns is NULL if it couldn't be built
+struct RleChunk rle_chunk_from_chunk(const struct Chunk* chunk);
+
+size_t rle_chunk_memory_usage(const struct RleChunk* chunk);
+
+// decodes z slices [z_begin, z_end) as RGBA8 texels straight into out, which should
+// point at the texel (0,0,z_begin) of the upload buffer, so the upload can be streamed in slabs
+void rle_chunk_decode_rgba(const struct RleChunk* chunk, int z_begin, int z_end, unsigned char* out);
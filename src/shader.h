@@ -0,0 +1,17 @@
+#pragma once
+
+#include "glm/fwd.hpp"
+
+// free out!
+int read_file(const char * path, char** out);
+
+void set_shader_value_float(const char * loc, float value, unsigned int shader_program);
+void set_shader_value_int(const char * loc, int value, unsigned int shader_program);
+void set_shader_value_vec2(const char * loc, glm::vec2 value, unsigned int shader_program);
+void set_shader_value_vec3(const char * loc, glm::vec3 value, unsigned int shader_program);
+void set_shader_value_ivec3(const char * loc, glm::ivec3 value, unsigned int shader_program);
+void set_shader_value_float_array(const char * loc, float* value, int size, unsigned int shader_program);
+void set_shader_value_matrix4(const char * loc, glm::mat4 value, unsigned int shader_program);
+
+unsigned int load_shader(const char* vertex_shaderPath, const char* fragment_shaderPath);
+unsigned int load_compute_shader(const char* compute_shaderPath);
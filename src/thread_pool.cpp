@@ -0,0 +1,108 @@
+#include "thread_pool.h"
+
+
+static void thread_pool_work(struct ThreadPool* pool)
+{
+        size_t begin;
+        while ((begin = pool->next.fetch_add(pool->grain)) < pool->count)
+        {
+                size_t end = begin+pool->grain < pool->count ? begin+pool->grain : pool->count;
+                pool->task(pool->context, begin, end);
+        }
+}
+
+
+static void thread_pool_worker(struct ThreadPool* pool)
+{
+        uint64_t seen = 0;
+        while (true)
+        {
+                {
+                        std::unique_lock<std::mutex> lock(pool->mutex);
+                        pool->wake.wait(lock, [&]{ return pool->quit || pool->generation != seen; });
+                        if (pool->quit)
+                                return;
+                        seen = pool->generation;
+                }
+
+                thread_pool_work(pool);
+
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                pool->busy_workers--;
+                if (pool->busy_workers == 0)
+                        pool->done.notify_one();
+        }
+}
+
+
+struct ThreadPool* create_thread_pool(int thread_count)
+{
+        if (thread_count < 0)
+        {
+                thread_count = (int)std::thread::hardware_concurrency()-1;
+                if (thread_count < 0)
+                        thread_count = 0;
+        }
+
+        struct ThreadPool* result = new ThreadPool;
+        result->generation = 0;
+        result->busy_workers = 0;
+        result->quit = false;
+        result->task = NULL;
+        result->context = NULL;
+        result->count = 0;
+        result->grain = 1;
+        result->next = 0;
+
+        for (int i = 0 ; i < thread_count ; i++)
+                result->threads.push_back(std::thread(thread_pool_worker, result));
+
+        return result;
+}
+
+
+void free_thread_pool(struct ThreadPool* pool)
+{
+        if (pool == NULL)
+                return;
+
+        {
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                pool->quit = true;
+        }
+        pool->wake.notify_all();
+        for (size_t i = 0 ; i < pool->threads.size() ; i++)
+                pool->threads[i].join();
+
+        delete pool;
+}
+
+
+void thread_pool_for(struct ThreadPool* pool, size_t count, size_t grain, ThreadPoolTask task, void* context)
+{
+        if (grain == 0)
+                grain = 1;
+        if (pool == NULL || pool->threads.empty() || count <= grain)
+        {
+                for (size_t begin = 0 ; begin < count ; begin += grain)
+                        task(context, begin, begin+grain < count ? begin+grain : count);
+                return;
+        }
+
+        {
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                pool->task = task;
+                pool->context = context;
+                pool->count = count;
+                pool->grain = grain;
+                pool->next = 0;
+                pool->busy_workers = pool->threads.size();
+                pool->generation++;
+        }
+        pool->wake.notify_all();
+
+        thread_pool_work(pool);
+
+        std::unique_lock<std::mutex> lock(pool->mutex);
+        pool->done.wait(lock, [&]{ return pool->busy_workers == 0; });
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// handles the items [begin, end) of a parallel loop
+typedef void (*ThreadPoolTask)(void* context, size_t begin, size_t end);
+
+
+// Fixed set of worker threads for data parallel loops.
+// thread_pool_for hands out blocks of grain items to the workers and the calling thread,
+// and only returns once every block is done, so the pool holds no work between calls.
+typedef struct ThreadPool
+{
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        // bumped for every loop so sleeping workers know there is new work
+        uint64_t generation;
+        int busy_workers;
+        bool quit;
+
+        ThreadPoolTask task;
+        void* context;
+        size_t count;
+        size_t grain;
+        std::atomic<size_t> next;
+}ThreadPool;
+
+
+// thread_count workers besides the caller, a negative count uses every hardware thread
+struct ThreadPool* create_thread_pool(int thread_count);
+void free_thread_pool(struct ThreadPool* pool);
+
+// runs task over [0, count) in blocks of grain items, pool can be NULL to run it on the caller
+void thread_pool_for(struct ThreadPool* pool, size_t count, size_t grain, ThreadPoolTask task, void* context);
@@ -0,0 +1,122 @@
+#include "upload_ring.h"
+
+#include <stdio.h>
+#include <glad/gl.h>
+
+// how long a single glClientWaitSync blocks before it is retried, in nanoseconds
+#define UPLOAD_RING_WAIT_TIMEOUT 1000000
+
+
+struct UploadRing create_upload_ring(size_t size)
+{
+        struct UploadRing result;
+
+        result.buffer = 0;
+        result.map = NULL;
+        result.size = size;
+        result.head_total = 0;
+        result.tail_total = 0;
+        result.fenced_total = 0;
+        result.fence_first = 0;
+        result.fence_count = 0;
+
+        if (glBufferStorage == NULL || glFenceSync == NULL)
+        {
+                printf("persistent buffer mapping isn't supported, textures upload from client memory.\n");
+                return result;
+        }
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &result.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, result.buffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+        result.map = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (result.map == NULL)
+        {
+                printf("Unable to map a %zu byte upload ring.\n",size);
+                glDeleteBuffers(1, &result.buffer);
+                result.buffer = 0;
+        }
+
+        return result;
+}
+
+
+void free_upload_ring(struct UploadRing* ring)
+{
+        for (int i = 0 ; i < ring->fence_count ; i++)
+                glDeleteSync((GLsync) ring->fences[(ring->fence_first+i)%UPLOAD_RING_MAX_FENCES].sync);
+        ring->fence_count = 0;
+
+        if (ring->buffer != 0)
+        {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->buffer);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                glDeleteBuffers(1, &ring->buffer);
+        }
+        ring->buffer = 0;
+        ring->map = NULL;
+}
+
+
+// blocks until the oldest fence signals and frees everything before it
+static void upload_ring_retire(struct UploadRing* ring)
+{
+        struct UploadFence* fence = ring->fences+ring->fence_first;
+        GLsync sync = (GLsync) fence->sync;
+
+        GLenum status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_RING_WAIT_TIMEOUT);
+        while (status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(sync, 0, UPLOAD_RING_WAIT_TIMEOUT);
+        if (status == GL_WAIT_FAILED)
+                printf("waiting on an upload ring fence failed.\n");
+
+        glDeleteSync(sync);
+        ring->tail_total = fence->end;
+        ring->fence_first = (ring->fence_first+1)%UPLOAD_RING_MAX_FENCES;
+        ring->fence_count--;
+}
+
+
+long long upload_ring_alloc(struct UploadRing* ring, size_t size)
+{
+        size = (size+UPLOAD_RING_ALIGNMENT-1) & ~(size_t)(UPLOAD_RING_ALIGNMENT-1);
+        if (ring->map == NULL || size > ring->size)
+                return -1;
+
+        // an allocation never wraps, the end of the ring is skipped instead
+        size_t offset = ring->head_total%ring->size;
+        if (offset+size > ring->size)
+        {
+                ring->head_total += ring->size-offset;
+                offset = 0;
+        }
+
+        while (ring->head_total+size-ring->tail_total > ring->size)
+        {
+                if (ring->fence_count == 0)
+                        upload_ring_fence(ring);
+                upload_ring_retire(ring);
+        }
+
+        ring->head_total += size;
+        return (long long)offset;
+}
+
+
+void upload_ring_fence(struct UploadRing* ring)
+{
+        if (ring->map == NULL || ring->head_total == ring->fenced_total)
+                return;
+        if (ring->fence_count == UPLOAD_RING_MAX_FENCES)
+                upload_ring_retire(ring);
+
+        struct UploadFence* fence = ring->fences+(ring->fence_first+ring->fence_count)%UPLOAD_RING_MAX_FENCES;
+        fence->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        fence->end = ring->head_total;
+        ring->fence_count++;
+        ring->fenced_total = ring->head_total;
+}
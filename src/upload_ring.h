@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define UPLOAD_RING_MAX_FENCES 64
+// offsets handed out are aligned to this so the SIMD converters write whole cache lines
+#define UPLOAD_RING_ALIGNMENT 64
+
+
+typedef struct UploadFence
+{
+        // GLsync, kept opaque so this header doesn't need the GL loader
+        void* sync;
+        // head_total when the fence was inserted, everything before it is free once the fence signals
+        uint64_t end;
+}UploadFence;
+
+
+// Pixel unpack buffer created with glBufferStorage and mapped once, persistently and coherently.
+// Callers write texels straight into map+offset (from any thread) and then issue
+// glTexSubImage3D with that offset while the ring is bound as GL_PIXEL_UNPACK_BUFFER,
+// so the driver never copies client memory.
+// Space is handed out in order around the ring, upload_ring_fence marks everything handed
+// out so far as in flight and upload_ring_alloc only waits when it catches up with a fence.
+typedef struct UploadRing
+{
+        unsigned int buffer;
+        unsigned char* map;
+        size_t size;
+        // bytes ever handed out and bytes known to be consumed by the GPU,
+        // monotonic so a full ring and an empty ring are told apart
+        uint64_t head_total;
+        uint64_t tail_total;
+        // head_total at the last fence
+        uint64_t fenced_total;
+        struct UploadFence fences[UPLOAD_RING_MAX_FENCES];
+        int fence_first;
+        int fence_count;
+}UploadRing;
+
+
+// map is NULL if persistent mapping isn't supported, callers then upload from client memory
+struct UploadRing create_upload_ring(size_t size);
+void free_upload_ring(struct UploadRing* ring);
+
+// returns the offset of size writable bytes, waiting for the GPU if the ring is full,
+// or -1 if size is larger than the ring
+long long upload_ring_alloc(struct UploadRing* ring, size_t size);
+// call after the uploads reading the allocations made so far have been issued
+void upload_ring_fence(struct UploadRing* ring);
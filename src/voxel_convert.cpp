@@ -0,0 +1,290 @@
+#include "voxel_convert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+
+// first can be any voxel, the vector kernels finish their tails here
+static void convert_scalar(const uint64_t* data, int bits, size_t first, size_t count, const uint32_t* colours, unsigned char* out)
+{
+        size_t per_word = 64/bits;
+        uint64_t mask = (1ull << bits)-1;
+        size_t w = first/per_word;
+        size_t j = first%per_word;
+        uint64_t word = count > 0 ? *(data+w) >> (j*bits) : 0;
+        for (size_t i = 0 ; i < count ; i++)
+        {
+                uint32_t texel = *(colours+(word & mask));
+                memcpy(out+i*4, &texel, sizeof(texel));
+                word >>= bits;
+                if (++j == per_word && i+1 < count)
+                {
+                        j = 0;
+                        word = *(data+(++w));
+                }
+        }
+}
+
+
+#ifdef CONVERT_X86
+
+// pshufb masks turning 4 indices into the bytes of their colours in a 4 colour register,
+// indexed by a byte of 2 bit indices or a nibble of 1 bit indices
+typedef struct ConvertShuffleMasks
+{
+        unsigned char two_bit[256][16];
+        unsigned char one_bit[16][16];
+}ConvertShuffleMasks;
+
+
+static const struct ConvertShuffleMasks* convert_shuffle_masks()
+{
+        static struct ConvertShuffleMasks masks;
+        static bool built = [](){
+                for (int value = 0 ; value < 256 ; value++)
+                {
+                        for (int voxel = 0 ; voxel < 4 ; voxel++)
+                        {
+                                int index = (value >> (voxel*2)) & 3;
+                                for (int byte = 0 ; byte < 4 ; byte++)
+                                        masks.two_bit[value][voxel*4+byte] = index*4+byte;
+                        }
+                }
+                for (int value = 0 ; value < 16 ; value++)
+                {
+                        for (int voxel = 0 ; voxel < 4 ; voxel++)
+                        {
+                                int index = (value >> voxel) & 1;
+                                for (int byte = 0 ; byte < 4 ; byte++)
+                                        masks.one_bit[value][voxel*4+byte] = index*4+byte;
+                        }
+                }
+                return true;
+        }();
+        (void)built;
+        return &masks;
+}
+
+
+__attribute__((target("ssse3")))
+static void convert_ssse3(const uint64_t* data, int bits, size_t first, size_t count, const uint32_t* colours, unsigned char* out)
+{
+        const struct ConvertShuffleMasks* masks = convert_shuffle_masks();
+        __m128i table = _mm_loadu_si128((const __m128i*)colours);
+        const unsigned char* bytes = (const unsigned char*)data + first*bits/8;
+
+        // every byte of indices is 8/bits voxels, 4 voxels per 16 byte store
+        size_t i = 0;
+        if (bits == 2)
+        {
+                for ( ; i+4 <= count ; i += 4, bytes++)
+                {
+                        __m128i mask = _mm_loadu_si128((const __m128i*)masks->two_bit[*bytes]);
+                        _mm_storeu_si128((__m128i*)(out+i*4), _mm_shuffle_epi8(table, mask));
+                }
+        }
+        else
+        {
+                for ( ; i+8 <= count ; i += 8, bytes++)
+                {
+                        __m128i low = _mm_loadu_si128((const __m128i*)masks->one_bit[*bytes & 15]);
+                        __m128i high = _mm_loadu_si128((const __m128i*)masks->one_bit[*bytes >> 4]);
+                        _mm_storeu_si128((__m128i*)(out+i*4), _mm_shuffle_epi8(table, low));
+                        _mm_storeu_si128((__m128i*)(out+i*4+16), _mm_shuffle_epi8(table, high));
+                }
+        }
+
+        if (i < count)
+                convert_scalar(data, bits, first+i, count-i, colours, out+i*4);
+}
+
+
+__attribute__((target("avx2")))
+static void convert_avx2(const uint64_t* data, int bits, size_t first, size_t count, const uint32_t* colours, int colour_count, unsigned char* out)
+{
+        const unsigned char* bytes = (const unsigned char*)data;
+        __m256i table = _mm256_setzero_si256();
+        bool permute = colour_count <= 8;
+        if (permute)
+                table = _mm256_loadu_si256((const __m256i*)colours);
+
+        __m256i shifts = _mm256_setr_epi32(0, bits, 2*bits, 3*bits, 4*bits, 5*bits, 6*bits, 7*bits);
+        __m256i mask = _mm256_set1_epi32((1 << bits)-1);
+
+        size_t i = 0;
+        for ( ; i+8 <= count ; i += 8)
+        {
+                size_t voxel = first+i;
+                __m256i indices;
+                if (bits <= 4)
+                {
+                        // 8 indices of up to 4 bits fit one 32 bit lane, shifted apart per voxel,
+                        // and never straddle a word since every word holds a multiple of 8
+                        size_t per_word = 64/bits;
+                        uint32_t packed = (uint32_t)(*(data+voxel/per_word) >> ((voxel%per_word)*bits));
+                        indices = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(packed), shifts), mask);
+                }
+                else if (bits == 8)
+                {
+                        indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(bytes+voxel)));
+                }
+                else
+                {
+                        indices = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(bytes+voxel*2)));
+                }
+
+                __m256i texels = permute ? _mm256_permutevar8x32_epi32(table, indices)
+                                         : _mm256_i32gather_epi32((const int*)colours, indices, 4);
+                _mm256_storeu_si256((__m256i*)(out+i*4), texels);
+        }
+
+        if (i < count)
+                convert_scalar(data, bits, first+i, count-i, colours, out+i*4);
+}
+
+#endif
+
+
+enum ConvertKernel convert_best_kernel()
+{
+#ifdef CONVERT_X86
+        if (__builtin_cpu_supports("avx2"))
+                return CONVERT_KERNEL_AVX2;
+        if (__builtin_cpu_supports("ssse3"))
+                return CONVERT_KERNEL_SSSE3;
+#endif
+        return CONVERT_KERNEL_SCALAR;
+}
+
+
+const char* convert_kernel_name(enum ConvertKernel kernel)
+{
+        switch (kernel)
+        {
+                case CONVERT_KERNEL_AVX2:
+                        return "avx2";
+                case CONVERT_KERNEL_SSSE3:
+                        return "ssse3";
+                default:
+                        return "scalar";
+        }
+}
+
+
+void convert_packed_to_rgba(enum ConvertKernel kernel, const uint64_t* data, int bits, size_t first, size_t count,
+                            const uint32_t* colours, int colour_count, unsigned char* out)
+{
+#ifdef CONVERT_X86
+        // one shuffle per 4 voxels beats the 8 wide shifts while the palette fits a register
+        if (kernel >= CONVERT_KERNEL_SSSE3 && bits <= 2)
+        {
+                convert_ssse3(data, bits, first, count, colours, out);
+                return;
+        }
+        if (kernel == CONVERT_KERNEL_AVX2)
+        {
+                convert_avx2(data, bits, first, count, colours, colour_count, out);
+                return;
+        }
+#endif
+        convert_scalar(data, bits, first, count, colours, out);
+}
+
+
+typedef struct ConvertJob
+{
+        enum ConvertKernel kernel;
+        const struct Chunk* chunk;
+        const uint32_t* colours;
+        unsigned char* out;
+}ConvertJob;
+
+
+static void convert_chunk_block(void* context, size_t begin, size_t end)
+{
+        const struct ConvertJob* job = (const struct ConvertJob*) context;
+        convert_packed_to_rgba(job->kernel, job->chunk->data, job->chunk->bits, begin, end-begin,
+                               job->colours, job->chunk->palette_size, job->out+begin*4);
+}
+
+
+void convert_chunk_to_rgba(const struct Chunk* chunk, unsigned char* out, struct ThreadPool* pool)
+{
+        // one entry per possible index so the vector kernels never read past the table,
+        // at least 8 so the permute kernel can load a full register
+        size_t colour_count = (size_t)1 << chunk->bits;
+        if (colour_count < 8)
+                colour_count = 8;
+        uint32_t* colours = (uint32_t*) calloc(colour_count, sizeof(uint32_t));
+        if (colours == NULL)
+        {
+                printf("Unable to allocate the chunk colour table.\n");
+                return;
+        }
+        for (int i = 0 ; i < chunk->palette_size ; i++)
+                *(colours+i) = voxel_to_rgba(*(chunk->palette+i));
+
+        static const enum ConvertKernel kernel = convert_best_kernel();
+        struct ConvertJob job = {kernel, chunk, colours, out};
+        size_t voxel_count = (size_t)chunk->size*chunk->size*chunk->size;
+        thread_pool_for(pool, voxel_count, CONVERT_BLOCK_VOXELS, convert_chunk_block, &job);
+
+        free(colours);
+}
+
+
+void convert_packed_to_indices(const uint64_t* data, int bits, size_t first, size_t count, int index_bytes, unsigned char* out)
+{
+        size_t per_word = 64/bits;
+        uint64_t mask = (1ull << bits)-1;
+        size_t w = first/per_word;
+        size_t j = first%per_word;
+        uint64_t word = count > 0 ? *(data+w) >> (j*bits) : 0;
+        for (size_t i = 0 ; i < count ; i++)
+        {
+                if (index_bytes == 1)
+                {
+                        *(out+i) = (unsigned char)(word & mask);
+                }
+                else
+                {
+                        uint16_t index = (uint16_t)(word & mask);
+                        memcpy(out+i*2, &index, sizeof(index));
+                }
+                word >>= bits;
+                if (++j == per_word && i+1 < count)
+                {
+                        j = 0;
+                        word = *(data+(++w));
+                }
+        }
+}
+
+
+typedef struct ConvertIndexJob
+{
+        const struct Chunk* chunk;
+        int index_bytes;
+        unsigned char* out;
+}ConvertIndexJob;
+
+
+static void convert_chunk_index_block(void* context, size_t begin, size_t end)
+{
+        const struct ConvertIndexJob* job = (const struct ConvertIndexJob*) context;
+        convert_packed_to_indices(job->chunk->data, job->chunk->bits, begin, end-begin, job->index_bytes, job->out+begin*job->index_bytes);
+}
+
+
+void convert_chunk_to_indices(const struct Chunk* chunk, unsigned char* out, int index_bytes, struct ThreadPool* pool)
+{
+        struct ConvertIndexJob job = {chunk, index_bytes, out};
+        size_t voxel_count = (size_t)chunk->size*chunk->size*chunk->size;
+        thread_pool_for(pool, voxel_count, CONVERT_BLOCK_VOXELS, convert_chunk_index_block, &job);
+}
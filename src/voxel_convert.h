@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "chunk.h"
+#include "thread_pool.h"
+
+// voxels per block handed to a worker, a multiple of every possible voxels per word
+#define CONVERT_BLOCK_VOXELS 32768
+
+
+// which palette lookup kernel convert_packed_to_rgba uses on this cpu
+enum ConvertKernel
+{
+        CONVERT_KERNEL_SCALAR,
+        // pshufb byte shuffles, palettes of up to 4 colours
+        CONVERT_KERNEL_SSSE3,
+        // 8 wide variable shifts with permutes up to 8 colours and gathers past that,
+        // 1 and 2 bit indices still go through the SSSE3 shuffles which are faster there
+        CONVERT_KERNEL_AVX2
+};
+
+
+enum ConvertKernel convert_best_kernel();
+const char* convert_kernel_name(enum ConvertKernel kernel);
+
+// converts count bit packed palette indices starting at voxel first to RGBA8 texels,
+// first has to be a multiple of 64. colours has to hold at least max(8, 1 << bits) entries,
+// the SSSE3 kernel loads 4 and the AVX2 permute 8 whatever colour_count (the palette size) is.
+// Kernels that don't handle bits or colour_count fall back to the next simpler one.
+void convert_packed_to_rgba(enum ConvertKernel kernel, const uint64_t* data, int bits, size_t first, size_t count,
+                            const uint32_t* colours, int colour_count, unsigned char* out);
+
+// chunk_to_rgba with the best kernel, split across pool (which can be NULL)
+void convert_chunk_to_rgba(const struct Chunk* chunk, unsigned char* out, struct ThreadPool* pool);
+
+// writes count palette indices starting at voxel first as index_bytes (1 or 2) wide integers,
+// the texel data of the GL_R8UI and GL_R16UI index textures
+void convert_packed_to_indices(const uint64_t* data, int bits, size_t first, size_t count, int index_bytes, unsigned char* out);
+void convert_chunk_to_indices(const struct Chunk* chunk, unsigned char* out, int index_bytes, struct ThreadPool* pool);
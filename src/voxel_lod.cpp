@@ -0,0 +1,116 @@
+#include "voxel_lod.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOD_ODD_PAIRS 0x5555555555555555ull
+#define LOD_NIBBLE_PAIRS 0x3333333333333333ull
+
+
+// keeps every other bit of x and packs them into the low 32 bits
+static inline uint64_t lod_compact_even_bits(uint64_t x)
+{
+        x &= LOD_ODD_PAIRS;
+        x = (x | (x >> 1)) & 0x3333333333333333ull;
+        x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+        x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+        x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+        return x;
+}
+
+
+// bit 2k of the result is set when at least 4 of the 8 voxels 2k and 2k+1 of the 4 rows are solid
+static inline uint64_t lod_majority(const uint64_t* rows[4], int w)
+{
+        uint64_t even = 0;
+        uint64_t odd = 0;
+        for (int i = 0 ; i < 4 ; i++)
+        {
+                // 2 bit counts of every pair of neighbours along x
+                uint64_t pairs = (rows[i][w] & LOD_ODD_PAIRS) + ((rows[i][w] >> 1) & LOD_ODD_PAIRS);
+                // spread to 4 bits so 4 rows of up to 2 add up without carrying over
+                even += pairs & LOD_NIBBLE_PAIRS;
+                odd += (pairs >> 2) & LOD_NIBBLE_PAIRS;
+        }
+        // a count of 4 to 8 has bit 2 or bit 3 set
+        uint64_t even_votes = ((even >> 2) | (even >> 3)) & 0x1111111111111111ull;
+        uint64_t odd_votes = ((odd >> 2) | (odd >> 3)) & 0x1111111111111111ull;
+        return even_votes | (odd_votes << 2);
+}
+
+
+// bits [first, last) of a word, clamped to it
+static inline uint64_t lod_bit_range(int first, int last)
+{
+        first = first > 0 ? first : 0;
+        uint64_t below_last = last >= 64 ? ~0ull : (1ull << last)-1;
+        return below_last & ~((1ull << first)-1);
+}
+
+
+void lod_downsample(const struct SolidMask* solid, const uint16_t* indices, const struct DirtyBox* box,
+                    struct SolidMask* out_solid, uint16_t* out_indices, int* occupancy)
+{
+        int size = solid->size;
+        int half = size/2;
+        int words = solid->words_per_row;
+        int out_words = out_solid->words_per_row;
+        int x0 = box->x/2, x1 = (box->x+box->width)/2;
+        int y0 = box->y/2, y1 = (box->y+box->height)/2;
+        int z0 = box->z/2, z1 = (box->z+box->depth)/2;
+
+        for (int z = z0 ; z < z1 ; z++)
+        {
+                for (int y = y0 ; y < y1 ; y++)
+                {
+                        const uint64_t* rows[4];
+                        for (int i = 0 ; i < 4 ; i++)
+                                rows[i] = solid->bits+((size_t)(2*z+i/2)*size+2*y+i%2)*words;
+                        uint64_t* out_row = out_solid->bits+((size_t)z*half+y)*out_words;
+
+                        // output word w takes its votes from source words 2w and 2w+1
+                        for (int w = x0/64 ; w <= (x1-1)/64 ; w++)
+                        {
+                                uint64_t votes = lod_compact_even_bits(lod_majority(rows, 2*w));
+                                if (2*w+1 < words)
+                                        votes |= lod_compact_even_bits(lod_majority(rows, 2*w+1)) << 32;
+                                uint64_t changed = (out_row[w] ^ votes) & lod_bit_range(x0-w*64, x1-w*64);
+                                out_row[w] ^= changed;
+
+                                int gained = __builtin_popcountll(changed & votes);
+                                int lost = __builtin_popcountll(changed & ~votes);
+                                occupancy[half+y] += gained-lost;
+                                occupancy[2*half+z] += gained-lost;
+                                for (uint64_t bits = changed ; bits != 0 ; bits &= bits-1)
+                                {
+                                        int bit = __builtin_ctzll(bits);
+                                        occupancy[w*64+bit] += ((votes >> bit) & 1) ? 1 : -1;
+                                }
+                        }
+
+                        // the index of the first source that agrees with the vote, in x, y, z order,
+                        // so the texel is drawn exactly when the mask says the voxel is solid
+                        uint16_t* out = out_indices+((size_t)(z-z0)*(y1-y0)+(y-y0))*(x1-x0);
+                        for (int x = x0 ; x < x1 ; x++)
+                        {
+                                uint64_t voxel_solid = (out_row[x/64] >> (x%64)) & 1;
+                                int source = 0;
+                                for (int i = 0 ; i < 8 ; i++)
+                                {
+                                        int sx = 2*x+(i&1);
+                                        if (((rows[i>>1][sx/64] >> (sx%64)) & 1) == voxel_solid)
+                                        {
+                                                source = i;
+                                                break;
+                                        }
+                                }
+                                int sx = 2*x+(source&1)-box->x;
+                                int sy = 2*y+((source>>1)&1)-box->y;
+                                int sz = 2*z+(source>>2)-box->z;
+                                out[x-x0] = indices[((size_t)sz*box->height+sy)*box->width+sx];
+                        }
+                }
+        }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "exposure.h"
+
+
+// Halves box of a chunk level along every axis, mask->size has to be even and out_solid has to be
+// created with half of it. box has even offsets and sizes, only the half of it is written to out_solid.
+// indices hold the palette index of every voxel of box and out_indices get those of the halved box,
+// both x fastest. An output voxel is solid when at least 4 of its 8 sources are and then takes the
+// index of its first solid source, otherwise the index of its first empty source. The votes of a row
+// of 32 output voxels are counted at once from 4 words of the mask with SWAR adds.
+// occupancy holds the solid voxels in every layer along x, y and z of out_solid, out_solid->size
+// entries per axis, and follows the output voxels that change.
+void lod_downsample(const struct SolidMask* solid, const uint16_t* indices, const struct DirtyBox* box,
+                    struct SolidMask* out_solid, uint16_t* out_indices, int* occupancy);
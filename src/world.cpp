@@ -0,0 +1,1493 @@
+#include "world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "int_math.h"
+#include "voxel_convert.h"
+#include "voxel_lod.h"
+
+// more boxes than this per chunk and a frame uploads their bounding box instead
+#define WORLD_MAX_UPLOAD_BOXES 64
+// full chunk uploads that fit the upload ring before loading waits on the GPU
+#define WORLD_UPLOAD_RING_CHUNKS 8
+
+
+struct World create_world(struct Lattice lattice, int chunk_size, float voxel_scale, enum ChunkBackend backend, enum WorldTextureFormat texture_format,
+                          WorldGenerator generator, const char* save_directory)
+{
+        struct World result;
+
+        result.chunk_size = chunk_size;
+        result.voxel_scale = voxel_scale;
+        result.backend = backend;
+        result.texture_format = texture_format;
+        result.generator = generator;
+        result.lattice = lattice;
+        result.save_directory = save_directory;
+        result.batch = NULL;
+        result.lod_distance = 2.0f;
+        result.clipmap = NULL;
+        result.brick_pool = NULL;
+        result.frame = 0;
+        result.reachable_from = glm::ivec3(0);
+        result.reachable_dirty = true;
+        result.pool = create_thread_pool(-1);
+        result.ring = create_upload_ring((size_t)WORLD_UPLOAD_RING_CHUNKS*chunk_size*chunk_size*chunk_size*4);
+
+        if (save_directory != NULL && mkdir(save_directory, 0755) != 0 && errno != EEXIST)
+        {
+                printf("Unable to create the save directory %s, chunks won't be saved.\n",save_directory);
+                result.save_directory = NULL;
+        }
+
+        return result;
+}
+
+
+void free_world(struct World* world)
+{
+        std::vector<glm::ivec3> positions;
+        for (auto& entry : world->chunks)
+                positions.push_back(entry.second->position);
+        for (size_t i = 0 ; i < positions.size() ; i++)
+                world_unload_chunk(world, positions[i]);
+
+        for (auto& entry : world->regions)
+        {
+                if (entry.second != NULL)
+                {
+                        close_region(entry.second);
+                        delete entry.second;
+                }
+        }
+        world->regions.clear();
+
+        free_upload_ring(&world->ring);
+        free_thread_pool(world->pool);
+        world->pool = NULL;
+}
+
+
+int world_set_clipmap(struct World* world, struct Clipmap* clipmap)
+{
+        // the window texture is GL_RGBA8 and shared, so chunks can't bring textures of their own
+        if (world->texture_format != WORLD_TEXTURE_RGBA || world->batch != NULL || world->brick_pool != NULL)
+        {
+                printf("Unable to use a clipmap, it needs RGBA textures without a batch or brick pool.\n");
+                return -1;
+        }
+        if (!world->chunks.empty() || clipmap->chunk_size != world->chunk_size)
+        {
+                printf("Unable to use a clipmap of %d voxel chunks on a world of %d voxel chunks with %zu resident.\n",clipmap->chunk_size,world->chunk_size,world->chunks.size());
+                return -1;
+        }
+
+        world->clipmap = clipmap;
+        return 0;
+}
+
+
+int world_set_brick_pool(struct World* world, struct BrickPool* pool)
+{
+        if (world->texture_format != WORLD_TEXTURE_RGBA || world->batch != NULL || world->clipmap != NULL)
+        {
+                printf("Unable to use a brick pool, it needs RGBA textures without a batch or clipmap.\n");
+                return -1;
+        }
+        // every voxel has to fall into a whole brick of the indirection texture
+        if (!world->chunks.empty() || world->chunk_size%BRICK_SIZE != 0)
+        {
+                printf("Unable to use a brick pool on a world of %d voxel chunks with %zu resident.\n",world->chunk_size,world->chunks.size());
+                return -1;
+        }
+
+        world->brick_pool = pool;
+        return 0;
+}
+
+
+uint64_t world_chunk_key(glm::ivec3 position)
+{
+        // 21 bits per axis is plenty of chunks in every direction
+        const uint64_t mask = (1ull << 21)-1;
+        return ((uint64_t)position.x & mask) | (((uint64_t)position.y & mask) << 21) | (((uint64_t)position.z & mask) << 42);
+}
+
+
+glm::ivec3 world_position_to_chunk(const struct World* world, glm::vec3 position)
+{
+        glm::vec3 local = position - glm::vec3(world->lattice.model_matrix[3]);
+        float extent = world->chunk_size*world->voxel_scale;
+
+        // see create_lattice_mesh_data, texture x runs towards -x and texture z towards -z,
+        // the mesh also starts one voxel above z = 0
+        return glm::ivec3(-(int)floorf(local.x/extent),
+                          (int)floorf(local.y/extent),
+                          (int)floorf((world->voxel_scale-local.z)/extent));
+}
+
+
+glm::ivec3 world_position_to_voxel(const struct World* world, glm::vec3 position)
+{
+        glm::vec3 local = position - glm::vec3(world->lattice.model_matrix[3]);
+        float scale = world->voxel_scale;
+
+        // same mirroring as world_position_to_chunk, texel x = size-1 sits at x = 0
+        return glm::ivec3(world->chunk_size-1-(int)floorf(local.x/scale),
+                          (int)floorf(local.y/scale),
+                          (int)floorf((scale-local.z)/scale));
+}
+
+
+struct WorldChunk* world_get_chunk(struct World* world, glm::ivec3 position)
+{
+        auto found = world->chunks.find(world_chunk_key(position));
+        if (found == world->chunks.end())
+                return NULL;
+        return found->second;
+}
+
+
+struct Region* world_get_region(struct World* world, glm::ivec3 position)
+{
+        if (world->save_directory == NULL)
+                return NULL;
+
+        glm::ivec3 region_position = region_of_chunk(position);
+        uint64_t key = world_chunk_key(region_position);
+        auto found = world->regions.find(key);
+        if (found != world->regions.end())
+                return found->second;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/r.%d.%d.%d.lreg", world->save_directory, region_position.x, region_position.y, region_position.z);
+
+        struct Region* result = new Region;
+        if (open_region(path, region_position, world->chunk_size, result) != 0)
+        {
+                delete result;
+                result = NULL;
+        }
+        // a region that failed to open is remembered as NULL so it isn't retried every frame
+        world->regions[key] = result;
+        return result;
+}
+
+
+int world_chunk_get_index(const struct World* world, const struct WorldChunk* chunk, int x, int y, int z)
+{
+        switch (world->backend)
+        {
+                case CHUNK_BACKEND_OCTREE:
+                        return octree_get_index(&chunk->octree, x, y, z);
+                case CHUNK_BACKEND_RLE:
+                        return rle_chunk_get_index(&chunk->rle, x, y, z);
+                default:
+                        return chunk_get_index(&chunk->chunk, x, y, z);
+        }
+}
+
+
+const struct Voxel* world_chunk_palette(const struct World* world, const struct WorldChunk* chunk, int* palette_size)
+{
+        switch (world->backend)
+        {
+                case CHUNK_BACKEND_OCTREE:
+                        *palette_size = chunk->octree.palette_size;
+                        return chunk->octree.palette;
+                case CHUNK_BACKEND_RLE:
+                        *palette_size = chunk->rle.palette_size;
+                        return chunk->rle.palette;
+                default:
+                        *palette_size = chunk->chunk.palette_size;
+                        return chunk->chunk.palette;
+        }
+}
+
+
+size_t world_chunk_memory_usage(const struct World* world, const struct WorldChunk* chunk)
+{
+        switch (world->backend)
+        {
+                case CHUNK_BACKEND_OCTREE:
+                        return octree_memory_usage(&chunk->octree);
+                case CHUNK_BACKEND_RLE:
+                        return rle_chunk_memory_usage(&chunk->rle);
+                default:
+                        return chunk_memory_usage(&chunk->chunk);
+        }
+}
+
+
+// bytes per texel of a chunk texture
+static int world_texel_size(const struct World* world, const struct WorldChunk* chunk)
+{
+        return world->texture_format == WORLD_TEXTURE_INDEXED ? chunk->index_bytes : 4;
+}
+
+
+// texel of the chunk's textures its voxel (0,0,0) is uploaded to
+static glm::ivec3 world_chunk_slot(const struct World* world, const struct WorldChunk* chunk)
+{
+        if (world->clipmap == NULL)
+                return glm::ivec3(0);
+        return clipmap_chunk_slot(world->clipmap, chunk->position);
+}
+
+
+// box of chunk voxels moved to the texels they are uploaded to
+static struct DirtyBox world_chunk_texture_box(const struct World* world, const struct WorldChunk* chunk, const struct DirtyBox* box)
+{
+        glm::ivec3 slot = world_chunk_slot(world, chunk);
+        struct DirtyBox result = *box;
+        result.x += slot.x;
+        result.y += slot.y;
+        result.z += slot.z;
+        return result;
+}
+
+
+// writes palette indices of box to out as index_bytes wide integers, x fastest
+static void world_chunk_extract_indices(const struct World* world, const struct WorldChunk* chunk, const struct DirtyBox* box, int index_bytes, unsigned char* out)
+{
+        for (int z = 0 ; z < box->depth ; z++)
+        {
+                for (int y = 0 ; y < box->height ; y++)
+                {
+                        for (int x = 0 ; x < box->width ; x++)
+                        {
+                                int index = world_chunk_get_index(world, chunk, box->x+x, box->y+y, box->z+z);
+                                if (index_bytes == 1)
+                                {
+                                        *out = (unsigned char)index;
+                                }
+                                else
+                                {
+                                        uint16_t wide = (uint16_t)index;
+                                        memcpy(out, &wide, sizeof(wide));
+                                }
+                                out += index_bytes;
+                        }
+                }
+        }
+}
+
+
+// writes the texels of box to out in the world's texture format, x fastest
+static void world_chunk_extract_box(const struct World* world, const struct WorldChunk* chunk, const struct DirtyBox* box, unsigned char* out)
+{
+        if (world->texture_format == WORLD_TEXTURE_INDEXED)
+        {
+                world_chunk_extract_indices(world, chunk, box, chunk->index_bytes, out);
+                return;
+        }
+
+        if (world->backend == CHUNK_BACKEND_OCTREE)
+        {
+                octree_extract_region(&chunk->octree, box->x, box->y, box->z, box->width, box->height, box->depth, out);
+                return;
+        }
+
+        int palette_size;
+        const struct Voxel* palette = world_chunk_palette(world, chunk, &palette_size);
+        uint32_t* colours = (uint32_t*) malloc(palette_size*sizeof(uint32_t));
+        if (colours == NULL)
+        {
+                printf("Unable to allocate the chunk colour table.\n");
+                return;
+        }
+        for (int i = 0 ; i < palette_size ; i++)
+                *(colours+i) = voxel_to_rgba(*(palette+i));
+
+        for (int z = 0 ; z < box->depth ; z++)
+        {
+                for (int y = 0 ; y < box->height ; y++)
+                {
+                        for (int x = 0 ; x < box->width ; x++)
+                        {
+                                uint32_t texel = *(colours+world_chunk_get_index(world, chunk, box->x+x, box->y+y, box->z+z));
+                                memcpy(out, &texel, sizeof(texel));
+                                out += 4;
+                        }
+                }
+        }
+
+        free(colours);
+}
+
+
+// palette copy of a chunk of any backend with every palette entry once, used to save edited
+// chunks, out is the chunk's own storage for palette chunks that have no duplicates
+static int world_chunk_to_chunk(const struct World* world, const struct WorldChunk* chunk, struct Chunk* out)
+{
+        if (world->backend == CHUNK_BACKEND_PALETTE && !chunk->palette_duplicates)
+        {
+                *out = chunk->chunk;
+                return 0;
+        }
+
+        int palette_size;
+        const struct Voxel* palette = world_chunk_palette(world, chunk, &palette_size);
+        struct Chunk result = create_chunk(world->chunk_size, *palette);
+        int* indices = (int*) malloc(palette_size*sizeof(int));
+        if (result.data == NULL || indices == NULL)
+        {
+                free_chunk(&result);
+                free(indices);
+                return -1;
+        }
+        for (int i = 0 ; i < palette_size ; i++)
+                *(indices+i) = chunk_palette_index(&result, *(palette+i));
+
+        int size = world->chunk_size;
+        for (int z = 0 ; z < size ; z++)
+        {
+                for (int y = 0 ; y < size ; y++)
+                {
+                        for (int x = 0 ; x < size ; x++)
+                                chunk_set_index(&result, x, y, z, *(indices+world_chunk_get_index(world, chunk, x, y, z)));
+                }
+        }
+
+        free(indices);
+        *out = result;
+        return 0;
+}
+
+
+typedef struct WorldConvertJob
+{
+        const struct World* world;
+        const struct WorldChunk* chunk;
+        unsigned char* out;
+}WorldConvertJob;
+
+
+// converts the z slices [begin, end) of a chunk, slices never share texels so they run in parallel
+static void world_convert_slices(void* context, size_t begin, size_t end)
+{
+        const struct WorldConvertJob* job = (const struct WorldConvertJob*) context;
+        int size = job->world->chunk_size;
+        unsigned char* out = job->out+begin*size*size*world_texel_size(job->world, job->chunk);
+        if (job->world->texture_format == WORLD_TEXTURE_INDEXED)
+        {
+                struct DirtyBox slab = {0, 0, (int)begin, size, size, (int)(end-begin)};
+                world_chunk_extract_indices(job->world, job->chunk, &slab, job->chunk->index_bytes, out);
+        }
+        else if (job->world->backend == CHUNK_BACKEND_OCTREE)
+        {
+                octree_extract_region(&job->chunk->octree, 0, 0, begin, size, size, end-begin, out);
+        }
+        else
+        {
+                rle_chunk_decode_rgba(&job->chunk->rle, begin, end, out);
+        }
+}
+
+
+// writes every texel of the chunk in the world's texture format
+static void world_chunk_to_texels(struct World* world, const struct WorldChunk* chunk, unsigned char* out)
+{
+        if (world->backend == CHUNK_BACKEND_PALETTE)
+        {
+                if (world->texture_format == WORLD_TEXTURE_INDEXED)
+                        convert_chunk_to_indices(&chunk->chunk, out, chunk->index_bytes, world->pool);
+                else
+                        convert_chunk_to_rgba(&chunk->chunk, out, world->pool);
+                return;
+        }
+
+        struct WorldConvertJob job = {world, chunk, out};
+        int slices = (world->chunk_size+(int)world->pool->threads.size())/((int)world->pool->threads.size()+1);
+        thread_pool_for(world->pool, world->chunk_size, slices, world_convert_slices, &job);
+}
+
+
+// space for length bytes of texels, in the upload ring when there is room, otherwise in client memory
+static unsigned char* world_upload_buffer(struct World* world, size_t length, long long* offset)
+{
+        *offset = upload_ring_alloc(&world->ring, length);
+        if (*offset != -1)
+                return world->ring.map+*offset;
+        return (unsigned char*) malloc(length);
+}
+
+
+// uploads texels from world_upload_buffer to box of the bound 3D texture and releases client memory
+static void world_upload_region(struct World* world, unsigned char* texels, long long offset, const struct DirtyBox* box, GLenum format, GLenum type)
+{
+        // index rows are rarely a multiple of 4 bytes
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        if (offset == -1)
+        {
+                glTexSubImage3D(GL_TEXTURE_3D, 0, box->x, box->y, box->z, box->width, box->height, box->depth, format, type, texels);
+                free(texels);
+        }
+        else
+        {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, world->ring.buffer);
+                glTexSubImage3D(GL_TEXTURE_3D, 0, box->x, box->y, box->z, box->width, box->height, box->depth, format, type, (void*)(uintptr_t)offset);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+
+// world_upload_region in the format of the chunk's colour texture
+static void world_upload_texels(struct World* world, const struct WorldChunk* chunk, unsigned char* texels, long long offset, const struct DirtyBox* box)
+{
+        if (world->texture_format == WORLD_TEXTURE_INDEXED)
+                world_upload_region(world, texels, offset, box, GL_RED_INTEGER, chunk->index_bytes == 1 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT);
+        else
+                world_upload_region(world, texels, offset, box, GL_RGBA, GL_UNSIGNED_BYTE);
+}
+
+
+// rebuilds the exposure bits of box from the solid mask and uploads them, binds the exposure texture
+static void world_upload_exposure(struct World* world, struct WorldChunk* chunk, const struct DirtyBox* box)
+{
+        glBindTexture(GL_TEXTURE_3D, chunk->lattice.exposure);
+
+        long long offset;
+        unsigned char* texels = world_upload_buffer(world, (size_t)box->width*box->height*box->depth, &offset);
+        if (texels == NULL)
+                return;
+        exposure_from_solid_mask(&chunk->solid, box, texels);
+        struct DirtyBox target = world_chunk_texture_box(world, chunk, box);
+        world_upload_region(world, texels, offset, &target, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
+}
+
+
+// allocates mip levels 1 to lod_count of the bound 3D texture and picks them by level
+static void world_allocate_lod_levels(int lod_count, int size, GLint internal_format, GLenum format, GLenum type)
+{
+        for (int level = 1 ; level <= lod_count ; level++)
+                glTexImage3D(GL_TEXTURE_3D, level, internal_format, size >> level, size >> level, size >> level, 0, format, type, 0);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, lod_count);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, lod_count > 0 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+}
+
+
+static void world_create_exposure(struct World* world, struct WorldChunk* chunk)
+{
+        int size = world->chunk_size;
+
+        // the clipmap's exposure texture already has a slot for the chunk
+        if (world->clipmap != NULL)
+        {
+                chunk->lattice.exposure = world->clipmap->lattice.exposure;
+        }
+        else
+        {
+                glGenTextures(1, &chunk->lattice.exposure);
+                glBindTexture(GL_TEXTURE_3D, chunk->lattice.exposure);
+                glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, size, size, size, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, 0);
+                world_allocate_lod_levels(chunk->lod_count, size, GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
+                glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        struct DirtyBox box = {0, 0, 0, size, size, size};
+        world_upload_exposure(world, chunk, &box);
+        upload_ring_fence(&world->ring);
+
+        glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+
+// copies the chunk palette into its shader storage buffer, the Voxel layout matches std430
+static void world_upload_palette(struct World* world, struct WorldChunk* chunk)
+{
+        int palette_size;
+        const struct Voxel* palette = world_chunk_palette(world, chunk, &palette_size);
+
+        if (chunk->lattice.palette_buffer == 0)
+                glGenBuffers(1, &chunk->lattice.palette_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, chunk->lattice.palette_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, palette_size*sizeof(struct Voxel), palette, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        chunk->uploaded_palette_size = palette_size;
+}
+
+
+// uploads every brick entry of the chunk to its indirection texture
+static void world_upload_brick_entries(struct World* world, struct WorldChunk* chunk)
+{
+        int bricks = world->chunk_size/BRICK_SIZE;
+        glBindTexture(GL_TEXTURE_3D, chunk->lattice.indirection);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, bricks, bricks, bricks, GL_RG_INTEGER, GL_UNSIGNED_INT, chunk->brick_entries);
+        glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+
+// the pool took the slot of brick away from the chunk, which draws it as air until it is back
+static void world_evict_brick(struct WorldChunk* chunk, int brick, int bricks)
+{
+        uint32_t* entry = chunk->brick_entries+2*brick;
+        entry[0] = BRICK_MISSING;
+        entry[1] = 0;
+
+        glBindTexture(GL_TEXTURE_3D, chunk->lattice.indirection);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, brick%bricks, brick/bricks%bricks, brick/(bricks*bricks), 1, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, entry);
+}
+
+
+// Points brick of the chunk at the RGBA texels starting at texels, rows row_length texels and
+// slices row_length rows apart. A brick of one colour only keeps the colour in its entry, any
+// other is uploaded to a pool slot. Returns false if the pool had no slot to give.
+// The entry is only changed in memory, the indirection texture has to be uploaded after.
+static bool world_store_brick(struct World* world, struct WorldChunk* chunk, int brick, const unsigned char* texels, int row_length)
+{
+        uint32_t* entry = chunk->brick_entries+2*brick;
+        bool resident = entry[0] != BRICK_UNIFORM && entry[0] != BRICK_MISSING;
+
+        uint32_t first;
+        memcpy(&first, texels, sizeof(first));
+        bool uniform = true;
+        for (int z = 0 ; z < BRICK_SIZE && uniform ; z++)
+        {
+                for (int y = 0 ; y < BRICK_SIZE && uniform ; y++)
+                {
+                        const unsigned char* row = texels+((size_t)z*row_length+y)*row_length*4;
+                        for (int x = 0 ; x < BRICK_SIZE && uniform ; x++)
+                                uniform = memcmp(row+x*4, &first, sizeof(first)) == 0;
+                }
+        }
+
+        if (uniform)
+        {
+                if (resident)
+                        brick_pool_release(world->brick_pool, (int)entry[0]);
+                entry[0] = BRICK_UNIFORM;
+                entry[1] = first;
+                return true;
+        }
+
+        if (!resident)
+        {
+                struct BrickOwner evicted;
+                int slot = brick_pool_alloc(world->brick_pool, chunk, brick, world->frame, &evicted);
+                entry[1] = 0;
+                if (slot == -1)
+                {
+                        entry[0] = BRICK_MISSING;
+                        return false;
+                }
+                if (evicted.owner != NULL)
+                        world_evict_brick((struct WorldChunk*)evicted.owner, evicted.brick, world->chunk_size/BRICK_SIZE);
+                entry[0] = (uint32_t)slot;
+        }
+        brick_pool_upload(world->brick_pool, (int)entry[0], texels, row_length);
+        return true;
+}
+
+
+// sorts every brick of the chunk into the pool and creates its indirection texture if needed
+static void world_upload_bricks(struct World* world, struct WorldChunk* chunk)
+{
+        int size = world->chunk_size;
+        int bricks = size/BRICK_SIZE;
+        size_t brick_count = (size_t)bricks*bricks*bricks;
+
+        chunk->lattice.texture = world->brick_pool->texture;
+        if (chunk->brick_entries == NULL)
+        {
+                chunk->brick_entries = (uint32_t*) malloc(brick_count*2*sizeof(uint32_t));
+                if (chunk->brick_entries == NULL)
+                {
+                        printf("Unable to allocate the brick entries of chunk %d %d %d.\n",chunk->position.x,chunk->position.y,chunk->position.z);
+                        return;
+                }
+                for (size_t i = 0 ; i < brick_count ; i++)
+                {
+                        chunk->brick_entries[2*i] = BRICK_MISSING;
+                        chunk->brick_entries[2*i+1] = 0;
+                }
+        }
+        if (chunk->lattice.indirection == 0)
+        {
+                glGenTextures(1, &chunk->lattice.indirection);
+                glBindTexture(GL_TEXTURE_3D, chunk->lattice.indirection);
+                glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32UI, bricks, bricks, bricks, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, 0);
+                glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        // the texels are read back while sorting, so they stay out of the write combined ring
+        unsigned char* texels = (unsigned char*) malloc((size_t)size*size*size*4);
+        if (texels == NULL)
+        {
+                printf("Unable to allocate the brick texels of chunk %d %d %d.\n",chunk->position.x,chunk->position.y,chunk->position.z);
+                return;
+        }
+        world_chunk_to_texels(world, chunk, texels);
+        for (size_t i = 0 ; i < brick_count ; i++)
+        {
+                int x = i%bricks*BRICK_SIZE;
+                int y = i/bricks%bricks*BRICK_SIZE;
+                int z = i/((size_t)bricks*bricks)*BRICK_SIZE;
+                world_store_brick(world, chunk, (int)i, texels+(((size_t)z*size+y)*size+x)*4, size);
+        }
+        free(texels);
+
+        world_upload_brick_entries(world, chunk);
+}
+
+
+// stores the bricks of the chunk overlapping box again after edits
+static void world_upload_brick_box(struct World* world, struct WorldChunk* chunk, const struct DirtyBox* box)
+{
+        int bricks = world->chunk_size/BRICK_SIZE;
+        unsigned char texels[BRICK_SIZE*BRICK_SIZE*BRICK_SIZE*4];
+
+        for (int z = box->z/BRICK_SIZE ; z <= (box->z+box->depth-1)/BRICK_SIZE ; z++)
+        {
+                for (int y = box->y/BRICK_SIZE ; y <= (box->y+box->height-1)/BRICK_SIZE ; y++)
+                {
+                        for (int x = box->x/BRICK_SIZE ; x <= (box->x+box->width-1)/BRICK_SIZE ; x++)
+                        {
+                                struct DirtyBox brick = {x*BRICK_SIZE, y*BRICK_SIZE, z*BRICK_SIZE, BRICK_SIZE, BRICK_SIZE, BRICK_SIZE};
+                                world_chunk_extract_box(world, chunk, &brick, texels);
+                                world_store_brick(world, chunk, x+bricks*(y+bricks*z), texels, BRICK_SIZE);
+                        }
+                }
+        }
+}
+
+
+// stamps the slots of the chunks about to be drawn, then brings back their evicted bricks,
+// evicting only slots no chunk of this frame is drawn from
+static void world_restore_bricks(struct World* world, const std::vector<std::pair<float, struct WorldChunk*>>& order)
+{
+        int bricks = world->chunk_size/BRICK_SIZE;
+        int brick_count = bricks*bricks*bricks;
+
+        for (size_t i = 0 ; i < order.size() ; i++)
+        {
+                const uint32_t* entries = order[i].second->brick_entries;
+                for (int j = 0 ; j < brick_count && entries != NULL ; j++)
+                {
+                        if (entries[2*j] != BRICK_UNIFORM && entries[2*j] != BRICK_MISSING)
+                                brick_pool_touch(world->brick_pool, (int)entries[2*j], world->frame);
+                }
+        }
+
+        unsigned char texels[BRICK_SIZE*BRICK_SIZE*BRICK_SIZE*4];
+        for (size_t i = 0 ; i < order.size() ; i++)
+        {
+                struct WorldChunk* chunk = order[i].second;
+                bool restored = false;
+                for (int j = 0 ; j < brick_count && chunk->brick_entries != NULL ; j++)
+                {
+                        if (chunk->brick_entries[2*j] != BRICK_MISSING)
+                                continue;
+                        struct DirtyBox brick = {j%bricks*BRICK_SIZE, j/bricks%bricks*BRICK_SIZE, j/(bricks*bricks)*BRICK_SIZE, BRICK_SIZE, BRICK_SIZE, BRICK_SIZE};
+                        world_chunk_extract_box(world, chunk, &brick, texels);
+                        // the pool is full of bricks drawn this frame
+                        if (!world_store_brick(world, chunk, j, texels, BRICK_SIZE))
+                                break;
+                        restored = true;
+                }
+                if (restored)
+                        world_upload_brick_entries(world, chunk);
+        }
+}
+
+
+// creates the chunk's texture with its level of detail mips, binds it
+static void world_create_chunk_texture(struct World* world, struct WorldChunk* chunk)
+{
+        int size = world->chunk_size;
+
+        glGenTextures(1, &chunk->lattice.texture);
+        glBindTexture(GL_TEXTURE_3D, chunk->lattice.texture);
+
+        if (world->texture_format == WORLD_TEXTURE_INDEXED)
+        {
+                int palette_size;
+                world_chunk_palette(world, chunk, &palette_size);
+                chunk->index_bytes = palette_size <= 256 ? 1 : 2;
+                GLenum type = chunk->index_bytes == 1 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+                glTexImage3D(GL_TEXTURE_3D, 0, chunk->index_bytes == 1 ? GL_R8UI : GL_R16UI, size, size, size, 0, GL_RED_INTEGER, type, 0);
+                world_allocate_lod_levels(chunk->lod_count, size, chunk->index_bytes == 1 ? GL_R8UI : GL_R16UI, GL_RED_INTEGER, type);
+                world_upload_palette(world, chunk);
+        }
+        else
+        {
+                glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, size, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+                world_allocate_lod_levels(chunk->lod_count, size, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+
+static void world_upload_chunk(struct World* world, struct WorldChunk* chunk)
+{
+        int size = world->chunk_size;
+
+        if (world->brick_pool != NULL)
+        {
+                world_upload_bricks(world, chunk);
+                return;
+        }
+
+        // a clipmap chunk only overwrites its slot of the window texture
+        if (world->clipmap != NULL)
+        {
+                chunk->lattice.texture = world->clipmap->lattice.texture;
+                glBindTexture(GL_TEXTURE_3D, chunk->lattice.texture);
+        }
+        else
+        {
+                world_create_chunk_texture(world, chunk);
+        }
+
+        long long offset;
+        unsigned char* texels = world_upload_buffer(world, (size_t)size*size*size*world_texel_size(world, chunk), &offset);
+        if (texels == NULL)
+        {
+                printf("Unable to allocate the texture upload buffer for chunk %d %d %d.\n",chunk->position.x,chunk->position.y,chunk->position.z);
+                glBindTexture(GL_TEXTURE_3D, 0);
+                return;
+        }
+
+        world_chunk_to_texels(world, chunk, texels);
+        struct DirtyBox box = {0, 0, 0, size, size, size};
+        struct DirtyBox target = world_chunk_texture_box(world, chunk, &box);
+        world_upload_texels(world, chunk, texels, offset, &target);
+        upload_ring_fence(&world->ring);
+
+        glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+
+// voxels the lattice shaders don't discard
+static bool world_voxel_solid(struct Voxel voxel)
+{
+        return voxel.a == 1.0f;
+}
+
+
+// rebuilds the solid mask and recounts the solid voxels of every layer of the chunk
+static void world_chunk_count_solids(const struct World* world, struct WorldChunk* chunk)
+{
+        int size = world->chunk_size;
+        if (chunk->occupancy == NULL || chunk->solid.bits == NULL)
+                return;
+        memset(chunk->occupancy, 0, 3*size*sizeof(int));
+
+        int palette_size;
+        const struct Voxel* palette = world_chunk_palette(world, chunk, &palette_size);
+        bool* solid = (bool*) malloc(palette_size*sizeof(bool));
+        if (solid == NULL)
+        {
+                printf("Unable to allocate the chunk solid table.\n");
+                return;
+        }
+        for (int i = 0 ; i < palette_size ; i++)
+                *(solid+i) = world_voxel_solid(*(palette+i));
+
+        for (int z = 0 ; z < size ; z++)
+        {
+                for (int y = 0 ; y < size ; y++)
+                {
+                        int row = 0;
+                        for (int x = 0 ; x < size ; x++)
+                        {
+                                bool voxel = *(solid+world_chunk_get_index(world, chunk, x, y, z));
+                                solid_mask_set(&chunk->solid, x, y, z, voxel);
+                                if (voxel)
+                                {
+                                        chunk->occupancy[x]++;
+                                        row++;
+                                }
+                        }
+                        chunk->occupancy[size+y] += row;
+                        chunk->occupancy[2*size+z] += row;
+                }
+        }
+
+        free(solid);
+}
+
+
+// uploads box of a mip level of the bound 3D texture from client memory
+static void world_upload_level(int level, const struct DirtyBox* box, GLenum format, GLenum type, const unsigned char* texels)
+{
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_3D, level, box->x, box->y, box->z, box->width, box->height, box->depth, format, type, texels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+
+// box grown by a voxel on every side and clamped to a level of size voxels,
+// the voxels whose exposure an edit of box can change
+static struct DirtyBox world_grow_box(const struct DirtyBox* box, int size)
+{
+        struct DirtyBox result;
+        int x1 = box->x+box->width+1 < size ? box->x+box->width+1 : size;
+        int y1 = box->y+box->height+1 < size ? box->y+box->height+1 : size;
+        int z1 = box->z+box->depth+1 < size ? box->z+box->depth+1 : size;
+        result.x = box->x > 0 ? box->x-1 : 0;
+        result.y = box->y > 0 ? box->y-1 : 0;
+        result.z = box->z > 0 ? box->z-1 : 0;
+        result.width = x1-result.x;
+        result.height = y1-result.y;
+        result.depth = z1-result.z;
+        return result;
+}
+
+
+// Downsamples box of the chunk into every level of detail and uploads the parts of the mip
+// levels of both textures it covers. box has to be aligned to 2^lod_count voxels so every
+// level halves it evenly. Levels are small next to the chunk, so they go through client
+// memory instead of the upload ring.
+static void world_update_lods(struct World* world, struct WorldChunk* chunk, const struct DirtyBox* box)
+{
+        size_t voxels = (size_t)box->width*box->height*box->depth;
+        // the exposure of a level also covers a voxel around the halved box
+        size_t exposure_bytes = (size_t)(box->width/2+2)*(box->height/2+2)*(box->depth/2+2);
+        size_t texel_bytes = voxels/8*4 > exposure_bytes ? voxels/8*4 : exposure_bytes;
+        uint16_t* indices = (uint16_t*) malloc(voxels*sizeof(uint16_t));
+        uint16_t* lod_indices = (uint16_t*) malloc(voxels/8*sizeof(uint16_t));
+        unsigned char* texels = (unsigned char*) malloc(texel_bytes);
+        if (indices == NULL || lod_indices == NULL || texels == NULL)
+        {
+                printf("Unable to allocate the level of detail buffers for chunk %d %d %d.\n",chunk->position.x,chunk->position.y,chunk->position.z);
+                free(indices);
+                free(lod_indices);
+                free(texels);
+                return;
+        }
+
+        world_chunk_extract_indices(world, chunk, box, 2, (unsigned char*)indices);
+        int palette_size;
+        const struct Voxel* palette = world_chunk_palette(world, chunk, &palette_size);
+
+        const struct SolidMask* solid = &chunk->solid;
+        struct DirtyBox source = *box;
+        for (int level = 1 ; level <= chunk->lod_count ; level++)
+        {
+                int lod_size = world->chunk_size >> level;
+                struct DirtyBox target = {source.x/2, source.y/2, source.z/2, source.width/2, source.height/2, source.depth/2};
+                size_t target_voxels = (size_t)target.width*target.height*target.depth;
+                struct SolidMask* lod_solid = chunk->lod_solids+level-1;
+                lod_downsample(solid, indices, &source, lod_solid, lod_indices, chunk->lod_occupancy[level-1]);
+
+                glBindTexture(GL_TEXTURE_3D, chunk->lattice.texture);
+                if (world->texture_format == WORLD_TEXTURE_INDEXED && chunk->index_bytes == 2)
+                {
+                        world_upload_level(level, &target, GL_RED_INTEGER, GL_UNSIGNED_SHORT, (unsigned char*)lod_indices);
+                }
+                else if (world->texture_format == WORLD_TEXTURE_INDEXED)
+                {
+                        for (size_t i = 0 ; i < target_voxels ; i++)
+                                texels[i] = (unsigned char)lod_indices[i];
+                        world_upload_level(level, &target, GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels);
+                }
+                else
+                {
+                        for (size_t i = 0 ; i < target_voxels ; i++)
+                        {
+                                uint32_t colour = voxel_to_rgba(*(palette+lod_indices[i]));
+                                memcpy(texels+i*4, &colour, sizeof(colour));
+                        }
+                        world_upload_level(level, &target, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+                }
+
+                struct DirtyBox grown = world_grow_box(&target, lod_size);
+                exposure_from_solid_mask(lod_solid, &grown, texels);
+                glBindTexture(GL_TEXTURE_3D, chunk->lattice.exposure);
+                world_upload_level(level, &grown, GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels);
+
+                solid = lod_solid;
+                source = target;
+                std::swap(indices, lod_indices);
+        }
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        free(indices);
+        free(lod_indices);
+        free(texels);
+}
+
+
+// box widened to the 2^lod_count voxel blocks it touches, what world_update_lods takes
+static struct DirtyBox world_lod_box(const struct WorldChunk* chunk, const struct DirtyBox* box)
+{
+        int block = 1 << chunk->lod_count;
+        struct DirtyBox result;
+        result.x = box->x & ~(block-1);
+        result.y = box->y & ~(block-1);
+        result.z = box->z & ~(block-1);
+        result.width = ((box->x+box->width+block-1) & ~(block-1))-result.x;
+        result.height = ((box->y+box->height+block-1) & ~(block-1))-result.y;
+        result.depth = ((box->z+box->depth+block-1) & ~(block-1))-result.z;
+        return result;
+}
+
+
+// Downsamples the whole chunk into every level of detail and points the level lattices at
+// the mip levels of its textures.
+static void world_build_lods(struct World* world, struct WorldChunk* chunk)
+{
+        int size = world->chunk_size;
+        if (chunk->lod_count == 0)
+                return;
+
+        struct DirtyBox all = {0, 0, 0, size, size, size};
+        world_update_lods(world, chunk, &all);
+
+        for (int level = 1 ; level <= chunk->lod_count ; level++)
+        {
+                // the level's mesh is as wide as the chunk's, its z range only moves with the voxel scale
+                struct Lattice* lod = chunk->lods+level-1;
+                *lod = world->lod_lattices[level-1];
+                lod->texture = chunk->lattice.texture;
+                lod->exposure = chunk->lattice.exposure;
+                lod->palette_buffer = chunk->lattice.palette_buffer;
+                lod->texture_level = level;
+                lod->occupancy = chunk->lod_occupancy[level-1];
+                lod->model_matrix = glm::translate(chunk->lattice.model_matrix, glm::vec3(0.0f, 0.0f, world->voxel_scale-lod->voxel_scale));
+        }
+}
+
+
+struct WorldChunk* world_load_chunk(struct World* world, glm::ivec3 position)
+{
+        struct WorldChunk* result = world_get_chunk(world, position);
+        if (result != NULL)
+                return result;
+
+        result = new WorldChunk;
+        result->position = position;
+        result->modified = false;
+        result->palette_duplicates = false;
+        result->index_bytes = 1;
+        result->uploaded_palette_size = 0;
+
+        struct Region* region = world_get_region(world, position);
+        struct Chunk generated;
+        if (region == NULL || region_load_chunk(region, position, &generated) != 0)
+        {
+                struct Voxel air = {0.0f, 0.0f, 0.0f, 0.0f, 0};
+                generated = create_chunk(world->chunk_size, air);
+                if (generated.data == NULL)
+                {
+                        delete result;
+                        return NULL;
+                }
+                if (world->generator != NULL)
+                        world->generator(&generated, position);
+                // edits are saved again on unload
+                if (region != NULL)
+                        region_save_chunk(region, position, &generated);
+        }
+
+        switch (world->backend)
+        {
+                case CHUNK_BACKEND_OCTREE:
+                        result->octree = octree_from_chunk(&generated);
+                        free_chunk(&generated);
+                        break;
+                case CHUNK_BACKEND_RLE:
+                        result->rle = rle_chunk_from_chunk(&generated);
+                        free_chunk(&generated);
+                        break;
+                default:
+                        result->chunk = generated;
+                        break;
+        }
+
+        float extent = world->chunk_size*world->voxel_scale;
+        result->lattice = world->lattice;
+        result->lattice.palette_buffer = 0;
+        result->lattice.model_matrix = glm::translate(world->lattice.model_matrix, glm::vec3(-position.x*extent, position.y*extent, -position.z*extent));
+        result->dirty = create_dirty_bricks(world->chunk_size);
+
+        result->occupancy = (int*) calloc(3*world->chunk_size, sizeof(int));
+        if (result->occupancy == NULL)
+                printf("Unable to allocate the chunk occupancy, every layer is drawn.\n");
+        result->solid = create_solid_mask(world->chunk_size);
+        world_chunk_count_solids(world, result);
+        result->lattice.occupancy = result->occupancy;
+        result->connectivity = connectivity_from_solid_mask(&result->solid, &world->connectivity_stack);
+        world->reachable_dirty = true;
+
+        // levels are downsampled from the solid mask, so they need it and an even size each,
+        // batches never draw them
+        result->lod_count = 0;
+        while (world->clipmap == NULL && world->brick_pool == NULL && world->batch == NULL && result->solid.bits != NULL && result->occupancy != NULL && result->lod_count < WORLD_MAX_LODS &&
+               result->lod_count < (int)world->lod_lattices.size() && (world->chunk_size >> result->lod_count)%2 == 0)
+        {
+                int lod_size = world->chunk_size >> (result->lod_count+1);
+                struct SolidMask* lod_solid = result->lod_solids+result->lod_count;
+                *lod_solid = create_solid_mask(lod_size);
+                int* lod_occupancy = (int*) calloc(3*lod_size, sizeof(int));
+                if (lod_solid->bits == NULL || lod_occupancy == NULL)
+                {
+                        printf("Unable to allocate level of detail %d of the chunk.\n",result->lod_count+1);
+                        free_solid_mask(lod_solid);
+                        free(lod_occupancy);
+                        break;
+                }
+                result->lod_occupancy[result->lod_count++] = lod_occupancy;
+        }
+        result->lattice.lods = result->lods;
+        result->lattice.lod_count = result->lod_count;
+        result->lattice.lod_distance = world->lod_distance;
+        result->brick_entries = NULL;
+        result->lattice.indirection = 0;
+
+        world_upload_chunk(world, result);
+        // without a solid mask every voxel would look buried, so the lattice goes without
+        result->lattice.exposure = 0;
+        if (result->solid.bits != NULL && result->occupancy != NULL)
+                world_create_exposure(world, result);
+        world_build_lods(world, result);
+        result->lattice.batch_slot = -1;
+        if (world->batch != NULL)
+                lattice_batch_insert(world->batch, &result->lattice);
+
+        world->chunks[world_chunk_key(position)] = result;
+        return result;
+}
+
+
+void world_unload_chunk(struct World* world, glm::ivec3 position)
+{
+        auto found = world->chunks.find(world_chunk_key(position));
+        if (found == world->chunks.end())
+                return;
+
+        struct WorldChunk* chunk = found->second;
+        world->chunks.erase(found);
+        world->reachable_dirty = true;
+
+        struct Region* region = chunk->modified ? world_get_region(world, position) : NULL;
+        struct Chunk saved;
+        if (region != NULL && world_chunk_to_chunk(world, chunk, &saved) == 0)
+        {
+                region_save_chunk(region, position, &saved);
+                if (saved.data != chunk->chunk.data)
+                        free_chunk(&saved);
+        }
+
+        if (world->batch != NULL)
+                lattice_batch_remove(world->batch, &chunk->lattice);
+        // a clipmap slot is left to the chunk that takes it over next
+        if (world->clipmap == NULL)
+        {
+                if (world->brick_pool == NULL)
+                        glDeleteTextures(1, &chunk->lattice.texture);
+                if (chunk->lattice.exposure != 0)
+                        glDeleteTextures(1, &chunk->lattice.exposure);
+        }
+        if (chunk->brick_entries != NULL)
+        {
+                int bricks = world->chunk_size/BRICK_SIZE;
+                for (int i = 0 ; i < bricks*bricks*bricks ; i++)
+                {
+                        uint32_t slot = chunk->brick_entries[2*i];
+                        if (slot != BRICK_UNIFORM && slot != BRICK_MISSING)
+                                brick_pool_release(world->brick_pool, (int)slot);
+                }
+                free(chunk->brick_entries);
+        }
+        if (chunk->lattice.indirection != 0)
+                glDeleteTextures(1, &chunk->lattice.indirection);
+        if (chunk->lattice.palette_buffer != 0)
+                glDeleteBuffers(1, &chunk->lattice.palette_buffer);
+        free_dirty_bricks(&chunk->dirty);
+        free(chunk->occupancy);
+        free_solid_mask(&chunk->solid);
+        for (int i = 0 ; i < chunk->lod_count ; i++)
+        {
+                free_solid_mask(chunk->lod_solids+i);
+                free(chunk->lod_occupancy[i]);
+        }
+        switch (world->backend)
+        {
+                case CHUNK_BACKEND_OCTREE:
+                        free_octree(&chunk->octree);
+                        break;
+                case CHUNK_BACKEND_RLE:
+                        free_rle_chunk(&chunk->rle);
+                        break;
+                default:
+                        free_chunk(&chunk->chunk);
+                        break;
+        }
+        delete chunk;
+}
+
+
+int world_set_voxel(struct World* world, glm::ivec3 voxel, struct Voxel value)
+{
+        int size = world->chunk_size;
+        glm::ivec3 position = glm::ivec3(floor_divide(voxel.x, size), floor_divide(voxel.y, size), floor_divide(voxel.z, size));
+        struct WorldChunk* chunk = world_get_chunk(world, position);
+        if (chunk == NULL)
+                return -1;
+
+        glm::ivec3 local = voxel - position*size;
+
+        int palette_size;
+        const struct Voxel* palette = world_chunk_palette(world, chunk, &palette_size);
+        int change = (int)world_voxel_solid(value) - (int)world_voxel_solid(*(palette+world_chunk_get_index(world, chunk, local.x, local.y, local.z)));
+        // a full palette drops the write, the counts and the solid mask only follow voxels that were written
+        int written;
+        switch (world->backend)
+        {
+                case CHUNK_BACKEND_OCTREE:
+                        written = octree_set(&chunk->octree, local.x, local.y, local.z, value);
+                        break;
+                case CHUNK_BACKEND_RLE:
+                        written = rle_chunk_set(&chunk->rle, local.x, local.y, local.z, value);
+                        break;
+                default:
+                        written = chunk_set(&chunk->chunk, local.x, local.y, local.z, value);
+                        break;
+        }
+        if (written != 0)
+                return -1;
+
+        if (chunk->occupancy != NULL && change != 0)
+        {
+                chunk->occupancy[local.x] += change;
+                chunk->occupancy[size+local.y] += change;
+                chunk->occupancy[2*size+local.z] += change;
+        }
+        if (change != 0)
+                solid_mask_set(&chunk->solid, local.x, local.y, local.z, change > 0);
+
+        if (chunk->dirty.count == 0)
+                world->dirty_chunks.push_back(world_chunk_key(position));
+        dirty_bricks_mark_voxel(&chunk->dirty, local.x, local.y, local.z);
+        chunk->modified = true;
+        return 0;
+}
+
+
+void world_upload_edits(struct World* world)
+{
+        struct DirtyBox boxes[WORLD_MAX_UPLOAD_BOXES];
+
+        for (size_t i = 0 ; i < world->dirty_chunks.size() ; i++)
+        {
+                auto found = world->chunks.find(world->dirty_chunks[i]);
+                if (found == world->chunks.end())
+                        continue;
+                struct WorldChunk* chunk = found->second;
+
+                if (world->texture_format == WORLD_TEXTURE_INDEXED)
+                {
+                        int palette_size;
+                        world_chunk_palette(world, chunk, &palette_size);
+                        // 8 bit indices can't address the palette any more, the texture is rebuilt wider
+                        if (palette_size > 256 && chunk->index_bytes == 1)
+                        {
+                                lattice_batch_release(&chunk->lattice);
+                                glDeleteTextures(1, &chunk->lattice.texture);
+                                world_upload_chunk(world, chunk);
+                                struct DirtyBox all = {0, 0, 0, world->chunk_size, world->chunk_size, world->chunk_size};
+                                if (chunk->lattice.exposure != 0)
+                                        world_upload_exposure(world, chunk, &all);
+                                world_build_lods(world, chunk);
+                                dirty_bricks_clear(&chunk->dirty);
+                                if (world->batch != NULL)
+                                        lattice_batch_update(world->batch, &chunk->lattice);
+                                chunk->connectivity = connectivity_from_solid_mask(&chunk->solid, &world->connectivity_stack);
+                                world->reachable_dirty = true;
+                                continue;
+                        }
+                        if (palette_size != chunk->uploaded_palette_size)
+                                world_upload_palette(world, chunk);
+                }
+
+                int box_count = dirty_bricks_coalesce(&chunk->dirty, boxes, WORLD_MAX_UPLOAD_BOXES);
+                if (world->brick_pool != NULL && chunk->brick_entries != NULL)
+                {
+                        for (int j = 0 ; j < box_count ; j++)
+                                world_upload_brick_box(world, chunk, boxes+j);
+                        world_upload_brick_entries(world, chunk);
+                }
+                else
+                {
+                        glBindTexture(GL_TEXTURE_3D, chunk->lattice.texture);
+                        for (int j = 0 ; j < box_count ; j++)
+                        {
+                                struct DirtyBox* box = boxes+j;
+                                long long offset;
+                                unsigned char* texels = world_upload_buffer(world, (size_t)box->width*box->height*box->depth*world_texel_size(world, chunk), &offset);
+                                if (texels == NULL)
+                                        continue;
+                                world_chunk_extract_box(world, chunk, box, texels);
+                                struct DirtyBox target = world_chunk_texture_box(world, chunk, box);
+                                world_upload_texels(world, chunk, texels, offset, &target);
+                        }
+                }
+
+                // an edit changes the exposure of the voxels next to it as well
+                for (int j = 0 ; j < box_count && chunk->lattice.exposure != 0 ; j++)
+                {
+                        struct DirtyBox grown = world_grow_box(boxes+j, world->chunk_size);
+                        world_upload_exposure(world, chunk, &grown);
+                }
+                // only the blocks of the levels of detail above the edits change
+                for (int j = 0 ; j < box_count && chunk->lod_count > 0 ; j++)
+                {
+                        struct DirtyBox block = world_lod_box(chunk, boxes+j);
+                        world_update_lods(world, chunk, &block);
+                }
+                dirty_bricks_clear(&chunk->dirty);
+                // occupied layer ranges of a GPU culled lattice may have changed
+                if (world->batch != NULL)
+                        lattice_batch_update(world->batch, &chunk->lattice);
+                // an edit can open or seal a path through the chunk
+                chunk->connectivity = connectivity_from_solid_mask(&chunk->solid, &world->connectivity_stack);
+                world->reachable_dirty = true;
+        }
+        glBindTexture(GL_TEXTURE_3D, 0);
+        upload_ring_fence(&world->ring);
+
+        world->dirty_chunks.clear();
+}
+
+
+static struct Voxel* world_chunk_mutable_palette(struct World* world, struct WorldChunk* chunk, int* palette_size)
+{
+        return (struct Voxel*) world_chunk_palette(world, chunk, palette_size);
+}
+
+
+int world_recolour(struct World* world, struct Voxel from, struct Voxel to)
+{
+        int changed = 0;
+        for (auto& entry : world->chunks)
+        {
+                struct WorldChunk* chunk = entry.second;
+                int palette_size;
+                struct Voxel* palette = world_chunk_mutable_palette(world, chunk, &palette_size);
+
+                // the palette is rewritten in place so indexed textures keep their texels,
+                // entries equal to to afterwards are only merged when the chunk is saved
+                int found = 0;
+                bool kept = false;
+                for (int i = 0 ; i < palette_size ; i++)
+                {
+                        if (voxel_equal(*(palette+i), from))
+                        {
+                                *(palette+i) = to;
+                                found++;
+                        }
+                        else if (voxel_equal(*(palette+i), to))
+                        {
+                                kept = true;
+                        }
+                }
+                if (found == 0)
+                        continue;
+                if (found > 1 || kept)
+                        chunk->palette_duplicates = true;
+
+                changed++;
+                chunk->modified = true;
+                bool solidity_changed = world_voxel_solid(from) != world_voxel_solid(to);
+                if (solidity_changed)
+                        world_chunk_count_solids(world, chunk);
+                if (world->texture_format == WORLD_TEXTURE_INDEXED)
+                        world_upload_palette(world, chunk);
+                // RGBA texels and the exposure bits of the recoloured voxels change everywhere
+                if (world->texture_format == WORLD_TEXTURE_RGBA || solidity_changed)
+                {
+                        if (chunk->dirty.count == 0)
+                                world->dirty_chunks.push_back(entry.first);
+                        dirty_bricks_mark_all(&chunk->dirty);
+                }
+        }
+        return changed;
+}
+
+
+void world_update(struct World* world, glm::vec3 position, int view_distance)
+{
+        glm::ivec3 centre = world_position_to_chunk(world, position);
+        if (world->clipmap != NULL)
+                view_distance = world->clipmap->chunks/2;
+
+        std::vector<glm::ivec3> far_chunks;
+        for (auto& entry : world->chunks)
+        {
+                glm::ivec3 offset = glm::abs(entry.second->position - centre);
+                if (offset.x > view_distance || offset.y > view_distance || offset.z > view_distance)
+                        far_chunks.push_back(entry.second->position);
+        }
+        for (size_t i = 0 ; i < far_chunks.size() ; i++)
+                world_unload_chunk(world, far_chunks[i]);
+
+        for (int z = -view_distance ; z <= view_distance ; z++)
+        {
+                for (int y = -view_distance ; y <= view_distance ; y++)
+                {
+                        for (int x = -view_distance ; x <= view_distance ; x++)
+                                world_load_chunk(world, centre+glm::ivec3(x, y, z));
+                }
+        }
+
+        // the chunks that left the window have been overwritten by the ones that entered it
+        if (world->clipmap != NULL && world->clipmap->origin != centre-glm::ivec3(view_distance))
+                clipmap_move(world->clipmap, centre-glm::ivec3(view_distance));
+}
+
+
+// index of a set of directions among the 27 that never hold both faces of an axis
+static int world_walk_directions_index(unsigned char directions)
+{
+        int index = 0;
+        for (int axis = 2 ; axis >= 0 ; axis--)
+                index = index*3 + ((directions >> (axis*2)) & 3);
+        return index;
+}
+
+
+// Walks from the camera's chunk to every chunk it could see into through air. A chunk is
+// entered through one of its faces and left through the faces air joins to it, never back
+// towards the camera along an axis already walked away from it, so paths only spread outwards.
+// Chunks entered are reachable even when they can't be left.
+static void world_update_reachable(struct World* world, glm::vec3 position)
+{
+        glm::ivec3 start = world_position_to_chunk(world, position);
+        if (!world->reachable_dirty && start == world->reachable_from)
+                return;
+        world->reachable_dirty = false;
+        world->reachable_from = start;
+
+        static const glm::ivec3 face_steps[CHUNK_FACE_COUNT] = {
+                glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, -1, 0),
+                glm::ivec3(0, 1, 0), glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1)
+        };
+
+        std::unordered_map<uint64_t, std::vector<uint32_t>>& walked = world->reachable_walked;
+        std::vector<struct WorldWalkStep>& queue = world->reachable_queue;
+        walked.clear();
+        queue.clear();
+
+        bool camera_resident = world_get_chunk(world, start) != NULL;
+        if (camera_resident)
+        {
+                walked[world_chunk_key(start)].assign(CHUNK_FACE_COUNT, 0);
+                // the camera can be anywhere inside its own chunk, so it sees out of every face
+                for (int face = 0 ; face < CHUNK_FACE_COUNT ; face++)
+                {
+                        struct WorldWalkStep step = {start+face_steps[face], face^1, (unsigned char)(1 << face)};
+                        queue.push_back(step);
+                }
+        }
+
+        for (size_t i = 0 ; i < queue.size() ; i++)
+        {
+                struct WorldWalkStep step = queue[i];
+                struct WorldChunk* chunk = world_get_chunk(world, step.position);
+                if (chunk == NULL)
+                        continue;
+
+                std::vector<uint32_t>& entered = walked[world_chunk_key(step.position)];
+                if (entered.empty())
+                        entered.assign(CHUNK_FACE_COUNT, 0);
+                uint32_t directions_bit = 1u << world_walk_directions_index(step.directions);
+                if (entered[step.face] & directions_bit)
+                        continue;
+                entered[step.face] |= directions_bit;
+
+                for (int face = 0 ; face < CHUNK_FACE_COUNT ; face++)
+                {
+                        // leaving through face walks towards the camera if its opposite was walked
+                        if ((step.directions >> (face^1)) & 1)
+                                continue;
+                        if (!connectivity_joins(&chunk->connectivity, step.face, face))
+                                continue;
+                        struct WorldWalkStep next = {step.position+face_steps[face], face^1, (unsigned char)(step.directions | 1 << face)};
+                        queue.push_back(next);
+                }
+        }
+
+        // without the camera's chunk there is nothing to walk from, so nothing is skipped
+        for (auto& entry : world->chunks)
+        {
+                bool reachable = !camera_resident || walked.count(entry.first) > 0;
+                if (world->batch != NULL)
+                        lattice_batch_set_reachable(world->batch, &entry.second->lattice, reachable);
+                else
+                        entry.second->lattice.reachable = reachable;
+        }
+}
+
+
+void world_draw(GLFWwindow* window, struct World* world, struct Camera* camera)
+{
+        world->frame++;
+
+        // the window holds every resident chunk, its lattice culls their layers as a whole
+        if (world->clipmap != NULL)
+        {
+                draw_lattice(window, &world->clipmap->lattice, camera, &world->draw_runs);
+                return;
+        }
+
+        world_update_reachable(world, camera->position);
+
+        // the resident chunks already have their slots, the GPU picks what to draw
+        if (world->batch != NULL && world->batch->gpu_culling)
+        {
+                lattice_batch_begin(window, world->batch, camera);
+                lattice_batch_end(world->batch, camera);
+                return;
+        }
+
+        // nearer chunks go first so the depth test rejects what they hide
+        std::vector<std::pair<float, struct WorldChunk*>>& order = world->draw_order;
+        order.clear();
+        glm::ivec3 camera_chunk = world_position_to_chunk(world, camera->position);
+        for (auto& entry : world->chunks)
+        {
+                if (!entry.second->lattice.reachable)
+                        continue;
+                glm::vec3 offset = glm::vec3(entry.second->position-camera_chunk);
+                order.push_back(std::make_pair(glm::dot(offset, offset), entry.second));
+        }
+        std::sort(order.begin(), order.end(), [](const std::pair<float, struct WorldChunk*>& a, const std::pair<float, struct WorldChunk*>& b)
+        {
+                return a.first < b.first;
+        });
+
+        if (world->batch == NULL)
+        {
+                if (world->brick_pool != NULL)
+                        world_restore_bricks(world, order);
+                for (size_t i = 0 ; i < order.size() ; i++)
+                        draw_lattice(window, &order[i].second->lattice, camera, &world->draw_runs);
+                return;
+        }
+
+        lattice_batch_begin(window, world->batch, camera);
+        for (size_t i = 0 ; i < order.size() ; i++)
+                lattice_batch_add(world->batch, &order[i].second->lattice, camera);
+        lattice_batch_end(world->batch, camera);
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <GLFW/glfw3.h>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+#include "brick_pool.h"
+#include "camera.h"
+#include "chunk.h"
+#include "clipmap.h"
+#include "lattice.h"
+#include "lattice_batch.h"
+#include "octree.h"
+#include "rle_chunk.h"
+#include "region.h"
+#include "dirty_bricks.h"
+#include "connectivity.h"
+#include "exposure.h"
+#include "thread_pool.h"
+#include "upload_ring.h"
+
+
+// coarser levels of detail a chunk keeps at most, each halving the one before
+#define WORLD_MAX_LODS 4
+
+
+// storage used for the voxels of resident chunks
+enum ChunkBackend
+{
+        CHUNK_BACKEND_PALETTE,
+        CHUNK_BACKEND_OCTREE,
+        CHUNK_BACKEND_RLE
+};
+
+
+// what the chunk 3D textures hold
+enum WorldTextureFormat
+{
+        // GL_RGBA8 colours converted on the CPU
+        WORLD_TEXTURE_RGBA,
+        // GL_R8UI or GL_R16UI palette indices, the fragment shader looks the colour up in
+        // the chunk's palette buffer, so recolouring a voxel type only re-uploads palettes
+        WORLD_TEXTURE_INDEXED
+};
+
+
+typedef struct WorldChunk
+{
+        glm::ivec3 position;
+        // only the member matching the world backend is valid
+        struct Chunk chunk;
+        struct Octree octree;
+        struct RleChunk rle;
+        // copy of the world lattice sharing its mesh and shader,
+        // with this chunk's translation and 3D texture
+        struct Lattice lattice;
+        // bytes per index of an indexed texture, 1 until the palette outgrows 256 entries
+        int index_bytes;
+        // palette entries in the palette buffer of an indexed texture
+        int uploaded_palette_size;
+        // bricks edited since the texture was last uploaded
+        struct DirtyBricks dirty;
+        // solid voxels in every layer along the texture x, y and z axes, chunk_size each,
+        // kept up to date on edits and read by the lattice to skip empty layers
+        int* occupancy;
+        // which voxels are solid, the exposure texture of the lattice is built from it
+        struct SolidMask solid;
+        // faces joined by air inside the chunk, refreshed when its edits are uploaded
+        struct ChunkConnectivity connectivity;
+        // levels of detail drawn from far away, lods[n-1] halves the chunk n times and samples
+        // mip n of its textures, they are downsampled again whenever edits are uploaded
+        struct Lattice lods[WORLD_MAX_LODS];
+        struct SolidMask lod_solids[WORLD_MAX_LODS];
+        int* lod_occupancy[WORLD_MAX_LODS];
+        int lod_count;
+        // BRICK_* entry pairs of every brick of a chunk in a brick pool, x fastest,
+        // the indirection texture of the lattice holds a copy
+        uint32_t* brick_entries;
+        // edited since it was loaded, so it has to be saved again on unload
+        bool modified;
+        // world_recolour left equal entries in the palette, they are merged when it's saved
+        bool palette_duplicates;
+}WorldChunk;
+
+
+// one step of the walk over reachable chunks, entering position through face
+// after walking away from the camera along directions (bits of CHUNK_FACE_*)
+typedef struct WorldWalkStep
+{
+        glm::ivec3 position;
+        int face;
+        unsigned char directions;
+}WorldWalkStep;
+
+
+// fills a freshly created chunk for the chunk coordinate position
+typedef void (*WorldGenerator)(struct Chunk* chunk, glm::ivec3 position);
+
+
+// Chunk coordinates follow the texture axes of a lattice, voxel (0,0,0) of chunk (0,0,0)
+// is texel (0,0,0) of its texture, so neighbouring chunks continue each other's voxels.
+// The lattice mesh mirrors x and z, which is why chunk translations flip those axes.
+typedef struct World
+{
+        int chunk_size;
+        float voxel_scale;
+        enum ChunkBackend backend;
+        enum WorldTextureFormat texture_format;
+        WorldGenerator generator;
+        // mesh, vao and shader shared by every resident chunk
+        struct Lattice lattice;
+        std::unordered_map<uint64_t, struct WorldChunk*> chunks;
+        // directory holding the region files, NULL keeps the world in memory only
+        const char* save_directory;
+        // regions opened so far, keyed like chunks by their region coordinate
+        std::unordered_map<uint64_t, struct Region*> regions;
+        // workers converting chunks to texels on upload
+        struct ThreadPool* pool;
+        // persistently mapped staging memory every texture upload is converted into
+        struct UploadRing ring;
+        // keys of chunks with dirty bricks, a chunk is listed once until its edits are uploaded
+        std::vector<uint64_t> dirty_chunks;
+        // draws every chunk with one indirect multi draw when set, NULL draws them one by one
+        struct LatticeBatch* batch;
+        // lattices with width chunk_size>>n and voxel_scale*2^n drawn with the shaders of lattice,
+        // the meshes of level n of every chunk, empty keeps chunks at full detail. Batches ignore them.
+        std::vector<struct Lattice> lod_lattices;
+        // chunk widths from which a chunk switches to lods[0], doubling for every further level
+        float lod_distance;
+        // Global lattice mode when set through world_set_clipmap, resident chunks upload into
+        // their slots of the clipmap's textures instead of textures of their own and only its
+        // lattice is drawn, world_update keeps the window on the loaded chunks.
+        struct Clipmap* clipmap;
+        // Colours of every chunk live in this pool when set through world_set_brick_pool, only
+        // bricks of more than one colour take up a slot. Bricks the pool evicted are uploaded
+        // again when their chunk is drawn.
+        struct BrickPool* brick_pool;
+        // frames drawn so far, what the pool's slots are stamped with when drawn
+        uint64_t frame;
+        // reachable chunks of the last world_draw and their squared distance to the camera
+        // in chunks, nearest first, kept so drawing doesn't allocate every frame
+        std::vector<std::pair<float, struct WorldChunk*>> draw_order;
+        // layer runs draw_lattice collects for every chunk drawn without a batch
+        struct LatticeRuns draw_runs;
+        // chunk the reachable chunks were last walked from, walked again when it changes
+        // or reachable_dirty is set after chunks load, unload or change their connectivity
+        glm::ivec3 reachable_from;
+        bool reachable_dirty;
+        // sets of directions every chunk was already entered with through each face, a chunk
+        // is only walked again by a path that got there differently, kept between walks
+        std::unordered_map<uint64_t, std::vector<uint32_t>> reachable_walked;
+        std::vector<struct WorldWalkStep> reachable_queue;
+        // scratch stack of the connectivity flood fill
+        std::vector<int> connectivity_stack;
+}World;
+
+
+// save_directory has to outlive the world, pass NULL to regenerate every chunk on load.
+// An indexed texture_format needs a lattice shader that reads the palette buffer at binding 0.
+struct World create_world(struct Lattice lattice, int chunk_size, float voxel_scale, enum ChunkBackend backend, enum WorldTextureFormat texture_format,
+                          WorldGenerator generator, const char* save_directory);
+// unloads every chunk, closes the region files, stops the thread pool and frees the upload ring
+void free_world(struct World* world);
+
+uint64_t world_chunk_key(glm::ivec3 position);
+// chunk coordinate containing a world space position
+glm::ivec3 world_position_to_chunk(const struct World* world, glm::vec3 position);
+// voxel coordinate containing a world space position, voxel v is voxel v - c*chunk_size of chunk c
+glm::ivec3 world_position_to_voxel(const struct World* world, glm::vec3 position);
+
+struct WorldChunk* world_get_chunk(struct World* world, glm::ivec3 position);
+// opens (creating if needed) the region file holding chunk coordinate position, NULL without a save directory
+struct Region* world_get_region(struct World* world, glm::ivec3 position);
+// reads the chunk from its region or generates and saves it, then uploads its texture,
+// returns the already resident chunk if there is one
+struct WorldChunk* world_load_chunk(struct World* world, glm::ivec3 position);
+// saves the chunk first if it was edited
+void world_unload_chunk(struct World* world, glm::ivec3 position);
+
+// sets a voxel of a resident chunk and marks its brick for upload, returns -1 and changes
+// nothing if the chunk isn't resident or its storage can't take the voxel (a full palette)
+int world_set_voxel(struct World* world, glm::ivec3 voxel, struct Voxel value);
+// uploads the dirty bricks of every edited chunk as a few glTexSubImage3D boxes per chunk
+void world_upload_edits(struct World* world);
+// replaces every from voxel of the resident chunks with to, indexed worlds only re-upload
+// the palettes while RGBA worlds re-upload the affected chunks, returns the number of chunks changed
+int world_recolour(struct World* world, struct Voxel from, struct Voxel to);
+
+// Switches the world to global lattice mode, clipmap has to outlive the world. Returns -1 and
+// leaves the world alone unless it has RGBA textures, no batch or brick pool, no resident
+// chunks yet and the clipmap's chunk size.
+int world_set_clipmap(struct World* world, struct Clipmap* clipmap);
+// Keeps the colours of every chunk in pool, which has to outlive the world. Returns -1 and
+// leaves the world alone unless it has RGBA textures, no batch or clipmap, no resident chunks
+// yet and a chunk size that is a multiple of BRICK_SIZE.
+int world_set_brick_pool(struct World* world, struct BrickPool* pool);
+
+// loads every chunk within view_distance chunks of position and unloads the rest,
+// with a clipmap view_distance is the one its window fits
+void world_update(struct World* world, glm::vec3 position, int view_distance);
+// Chunks are drawn nearest first, through the world's batch if it has one. Chunks no path
+// of air leads to from the camera's chunk without doubling back are skipped.
+void world_draw(GLFWwindow* window, struct World* world, struct Camera* camera);
+
+// voxel access independent of the world backend, x, y, z are chunk local
+int world_chunk_get_index(const struct World* world, const struct WorldChunk* chunk, int x, int y, int z);
+const struct Voxel* world_chunk_palette(const struct World* world, const struct WorldChunk* chunk, int* palette_size);
+size_t world_chunk_memory_usage(const struct World* world, const struct WorldChunk* chunk);